@@ -28,6 +28,7 @@
 #include "libmicromodel/vertex.h"
 #include "libmicromodel/basis.h"
 #include "libmicromodel/color.h"
+#include "libmicromodel/halfedge.h"
 
 /* Data Definitions */
 
@@ -75,11 +76,14 @@ static void register_reset(void) {
 	vertex_order = 0;
 	facet_order = 0;
 }
-static void register_vertex(Vertex *v) {
+static void register_vertex(Vertex *v, bool need_order) {
+	// need_order : we will need order_of_vertex(v)
 	assert(v);
-	cntHashkey key = { .ptr = v };
-	assert(NULL == cntHash_get(vertex2order, key));
-	cntHash_put(vertex2order, key, &vertex_order);
+	if (need_order) {
+		cntHashkey key = { .ptr = v };
+		assert(NULL == cntHash_get(vertex2order, key));
+		cntHash_put(vertex2order, key, &vertex_order);
+	}
 	cntList_set(order2vertex, vertex_order, &v);
 	vertex_order++;
 }
@@ -93,14 +97,16 @@ static void register_facet(Facet *f) {
 
 static void print_vertex(Vertex *vertex) {
 	assert(vertex);
-	Vec *pos = Vertex_position(vertex);
+	Vec position;
+	const Vec *pos = Vertex_get_position(vertex, &position);
 	assert(pos);
 	printf("%e %e %e\n", Vec_coord(pos, 0), Vec_coord(pos, 1), Vec_coord(pos, 2));
 }
 
 static void print_vertex_n_normal(Vertex *vertex) {
 	assert(vertex);
-	const Vec *pos = Vertex_position(vertex);
+	Vec position;
+	const Vec *pos = Vertex_get_position(vertex, &position);
 	const Vec *norm = Vertex_normal(vertex);
 	assert(pos && norm);
 	printf("%e %e %e %e %e %e %e %e\n",
@@ -111,7 +117,8 @@ static void print_vertex_n_normal(Vertex *vertex) {
 
 static void print_vertex_n_normal_n_color(Vertex *vertex) {
 	assert(vertex);
-	const Vec *pos = Vertex_position(vertex);
+	Vec position;
+	const Vec *pos = Vertex_get_position(vertex, &position);
 	const Vec *norm = Vertex_normal(vertex);
 	unsigned colorname = Vertex_color(vertex);
 	assert(pos && norm);
@@ -141,6 +148,19 @@ static void print_facet(Facet *facet, const char *color) {
 	printf("%s\n", color);
 }
 
+static void print_facet_half_edges(const HalfEdges *he, uint32_t facet, const char *color) {
+	// vertices are registered in the same order than the half-edges tables
+	assert(he && facet < he->nb_facets);
+	printf("%u ", Facet_size(he->facets[facet]));
+	uint32_t const first = he->facet_half[facet];
+	uint32_t h = first;
+	if (HALFEDGE_NONE != h) do {
+		printf("%u ", HalfEdges_vertex(he, h));
+		h = HalfEdges_next(he, h);
+	} while (h != first);
+	printf("%s\n", color);
+}
+
 static void print_basis(Basis *basis, unsigned color) {
 	assert(basis && color<3);
 	const char *colors[3][3] = {
@@ -182,28 +202,35 @@ int grid2gcl(unsigned sel_name, unsigned basis_name, const char *tiff_filename)
 			puts("STCNOFF");
 		}
 		printf("%u %u %u\n", nb_vertices, nb_facets, nb_edges);
+		Grid_update_normals();	// in one sweep, so that printing the vertices only reads them
 		unsigned i;
+		const HalfEdges *he = Grid_half_edge_view();	// NULL if it could not be built
 		/* vertices */
-		Grid_reset_vertices();
+		if (!he) Grid_reset_vertices();
 		for (i=0; i<nb_vertices; i++) {
-			Vertex *vertex = Grid_each_vertex();
+			Vertex *vertex = he ? he->vertices[i] : Grid_each_vertex();
 			assert(vertex);
-			register_vertex(vertex);
+			register_vertex(vertex, !he);
 			if (show_facet_sel) {
 				print_vertex_n_normal(vertex);
 			} else {
 				print_vertex_n_normal_n_color(vertex);
 			}
 		}
-		assert(Grid_each_vertex() == NULL);
+		assert(he || Grid_each_vertex() == NULL);
 		/* Facets */
-		Grid_reset_facets();
+		if (!he) Grid_reset_facets();
 		for (i=0; i<nb_facets; i++) {
-			Facet *facet = Grid_each_facet();
+			Facet *facet = he ? he->facets[i] : Grid_each_facet();
 			register_facet(facet);
-			print_facet(facet, show_facet_sel && Grid_selected(sel_name, facet) ? "1. 0. 0." : "");
+			const char *color = show_facet_sel && Grid_selected(sel_name, facet) ? "1. 0. 0." : "";
+			if (he) {
+				print_facet_half_edges(he, i, color);
+			} else {
+				print_facet(facet, color);
+			}
 		}
-		assert(Grid_each_facet() == NULL);
+		assert(he || Grid_each_facet() == NULL);
 		puts("}");
 		/* Selection */
 		if (sel_name>0) switch (Grid_get_selection_type(sel_name)) {
@@ -274,10 +301,10 @@ int grid2gcl(unsigned sel_name, unsigned basis_name, const char *tiff_filename)
 					unsigned bi = Vertex_basis(v);
 					if (bi>0) {
 						if (bi == basis_name) {
-							if (0. == v->skin_ratio) {
+							if (0. == Vertex_skin_ratio(v)) {
 								puts("0 1. 0 .7");
 							} else {
-								printf("0 %e 1 .7\n", 1.-v->skin_ratio);
+								printf("0 %e 1 .7\n", 1.-Vertex_skin_ratio(v));
 							}
 						} else if (Grid_get_basis_father(bi) == basis_name) {
 							puts(".7 .7 .7 .7");
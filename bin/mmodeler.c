@@ -447,7 +447,7 @@ void reset_tiff(void) {
 /* Load a MML file and reset modeler */
 
 void reset_grid(void) {
-	MCom_reset();
+	MCom_reuse();
 	unsigned bin_size;
 	mmlPatchSet *patchset;
 	unsigned char *bin = mml2bin(SrcBuf_get_text(mml), &bin_size, &patchset);
@@ -564,6 +564,10 @@ static void syntax(void) {
 		"  -t file, --texture=file : a tiff file to use as the texture\n"
 		"  -p patches, --patch=patches : the patch string to apply\n"
 		"                           (mmodel.mml by default)\n"
+		"  -c, --check             : check the grid after each command\n"
+		"                           (twice for a thorough check)\n"
+		"  -m, --memory            : log the memory used by the grid\n"
+		"                           after each evaluation\n"
 	);
 }
 
@@ -588,6 +592,8 @@ int main(int nb_args, char *argv[]) {
 	log_warn_level log_level = LOG_OPTIONAL;
 	const char *filename = NULL;
 	const char *init_patches = NULL;
+	MCom_validation validation = MCom_VALIDATE_NONE;
+	bool memory_stats = false;
 	/* Command line */
 	while (1) {
 		static struct option long_options[] = {
@@ -597,9 +603,11 @@ int main(int nb_args, char *argv[]) {
 			{ "help", no_argument, NULL, 'h' },
 			{ "quiet", no_argument, NULL, 'q' },
 			{ "debug", no_argument, NULL, 'd' },
+			{ "check", no_argument, NULL, 'c' },
+			{ "memory", no_argument, NULL, 'm' },
 			{ 0,0,0,0 },
 		};
-		int c = getopt_long(nb_args, argv, "i:p:t:hqd", long_options, NULL);
+		int c = getopt_long(nb_args, argv, "i:p:t:hqdcm", long_options, NULL);
 		switch (c) {
 			case -1:
 				goto end_opts;
@@ -621,6 +629,12 @@ int main(int nb_args, char *argv[]) {
 			case 'd':
 				log_level = LOG_DEBUG;
 				break;
+			case 'c':
+				validation = validation == MCom_VALIDATE_NONE ? MCom_VALIDATE_QUICK : MCom_VALIDATE_THOROUGH;
+				break;
+			case 'm':
+				memory_stats = true;
+				break;
 			case ':':
 				missing_parameter();
 				break;
@@ -642,6 +656,8 @@ end_opts:
 	if (!mml) log_fatal("Cannot set up source buffer ?");
 	atexit(free_mml);
 	MCom_reset();
+	MCom_set_validation(validation);
+	MCom_set_memory_stats(memory_stats);
 	/* XForms init */
 	log_warning(LOG_DEBUG, "Init XForms");
 	fl_initialize(&nb_args, argv, 0, 0, 0);
@@ -18,8 +18,10 @@
 #include "../config.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <libcnt/cnt.h>
 #include "libmicromodel/mml2bin.h"
+#include "libmicromodel/mcommander.h"
 #include "libmicromodel/grid.h"
 
 static const char pantin[] =
@@ -35,7 +37,63 @@ static const char pantin[] =
 "select	\\1	6\n"
 "extr1	\\1	0	0,0,0	1.	1. \\0\n"
 "extr	\\1	0	0,0,0	1.	\\0\n"
-"extr	\\1	0	0,0,0	.2	\\0\n";
+"extr	\\1	0	0,0,0	.2	\\0\n"
+"newsel	vertex\n"
+"selsphere	\\3	0,0,0	1.5\n"
+"selcyl	\\3	0,0,-1	0,0,1	.5\n"
+"selnormal	\\3	0,0,1	.5\n"
+"sellength	\\3	.5	1\n"
+"compact\n";
+
+// on a cube of side 1 centered on the origin, each in a new selection
+static const char selections[] =
+"cube	\\0\n"
+"newsel	vertex\n"
+"selbox	\\1	0,0,0	1,1,1\n"
+"newsel	vertex\n"
+"selsphere	\\2	.5,.5,.5	1.1\n"
+"newsel	vertex\n"
+"selhalf	\\3	0,0,0	0,0,1\n"
+"newsel	vertex\n"
+"selcyl	\\4	.5,.5,-1	.5,.5,1	.1\n"
+"newsel	facet\n"
+"selnormal	\\5	0,0,1	.5\n"
+"color	1.	0.	0.\n"
+"paint	\\3	\\1\n"
+"newsel	vertex\n"
+"selcolor	\\6	\\1\n"
+"newsel	vertex\n"
+"selbasis	\\7	\\0\n"
+"newsel	vertex\n"
+"seluv	\\8	-.1	-.1	.1	.1\n"
+"newsel	edge\n"
+"sellength	\\9	.5	1\n"
+"newsel	facet\n"
+"select	\\10	0\n"
+"select	\\10	1\n"
+"select	\\10	2\n"
+"select	\\10	3\n"
+"select	\\10	5\n"
+"shrink	\\10	1\n";
+static const unsigned selection_sizes[] = { 1, 4, 4, 2, 1, 4, 8, 8, 12, 1 };
+
+static const char zap_compact[] =
+"cube	\\0\n"
+"newsel	vertex\n"
+"select	\\1	0\n"
+"zap	\\1\n"
+"compact\n"
+"memstats\n";
+
+static bool run(const char *mml) {
+	// every instruction must succeed
+	unsigned size;
+	unsigned char *bin = mml2bin(mml, &size, NULL);
+	if (!bin) return false;
+	bool ok = MCom_binexec_all(bin, size) == size;
+	mem_unregister(bin);
+	return ok;
+}
 
 int main(void) {
 	int ret = EXIT_FAILURE;
@@ -46,6 +104,20 @@ int main(void) {
 	if (!bin) goto exit;
 	mem_unregister(bin);
 	printf("Resulting size : %u bytes\n", size);
+	if (!run(selections)) goto exit;
+	for (unsigned s=0; s<sizeof(selection_sizes)/sizeof(*selection_sizes); s++) {
+		if (Grid_selection_size(s+1) != selection_sizes[s]) {
+			printf("Selection %u has %u elements instead of %u\n", s+1, Grid_selection_size(s+1), selection_sizes[s]);
+			goto exit;
+		}
+	}
+	MCom_reset();
+	// names are dense again once compacted
+	unsigned nb_vertices, nb_edges, nb_facets;
+	if (!run(zap_compact)) goto exit;
+	Grid_size(&nb_vertices, &nb_edges, &nb_facets);
+	if (nb_vertices != 7 || nb_edges != 11 || nb_facets != 6 || !Grid_get_vertex(6) || !Grid_get_edge(10) || !Grid_get_facet(5)) goto exit;
+	MCom_reset();
 	ret = EXIT_SUCCESS;
 exit:
 	return ret;
@@ -19,8 +19,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
 #include <libcnt/cnt.h>
 #include "libmicromodel/grid.h"
+#include "libmicromodel/halfedge.h"
+
+#ifdef MICROMODEL_FLOAT_POSITIONS
+#define EPSILON 1e-5	// positions are rounded when stored
+#else
+#define EPSILON 1e-9
+#endif
 
 static int build_pantin(void) {
 	int ret = 0;
@@ -51,12 +60,569 @@ ret1:
 	return ret;
 }
 
+static bool check_half_edges(void) {
+	// tables must match the facets and edges
+	const HalfEdges *he = Grid_half_edge_view();
+	if (!he) return false;
+	for (uint32_t f=0; f<he->nb_facets; f++) {
+		Facet *facet = he->facets[f];
+		uint32_t h = he->facet_half[f];
+		for (unsigned o=0; o<Facet_size(facet); o++) {
+			if (HalfEdges_facet(he, h) != f) return false;
+			if (he->vertices[HalfEdges_vertex(he, h)] != Facet_get_vertex(facet, o)) return false;
+			if (he->edges[HalfEdges_edge(h)] != Facet_get_edge(facet, o)) return false;
+			h = HalfEdges_next(he, h);
+		}
+		if (h != he->facet_half[f]) return false;
+	}
+	for (uint32_t e=0; e<he->nb_edges; e++) {
+		uint32_t h = 2*e;
+		if (he->vertices[HalfEdges_vertex(he, h)] != Edge_get_vertex(he->edges[e], SOUTH)) return false;
+		if (he->vertices[HalfEdges_vertex(he, HalfEdges_twin(h))] != Edge_get_vertex(he->edges[e], NORTH)) return false;
+	}
+	return true;
+}
+
+static bool check_iterators(void) {
+	// split ranges must cover all elements once
+	unsigned nb_vertices, count = 0;
+	Grid_size(&nb_vertices, NULL, NULL);
+	GridIter all = Grid_iter(GridSel_VERTEX);
+	for (unsigned p=0; p<3; p++) {
+		GridIter part = GridIter_split(&all, 3, p);
+		while (GridIter_next(&part)) count ++;
+	}
+	if (count != nb_vertices) return false;
+	count = 0;
+	GridIter sel = Grid_iter_selection(S0);
+	while (GridIter_next(&sel)) count ++;
+	return count == Grid_selection_size(S0);
+}
+
+static bool check_compact(void) {
+	// names must be dense once compacted
+	unsigned nb_vertices, nb_edges, nb_facets;
+	Grid_size(&nb_vertices, &nb_edges, &nb_facets);
+	if (!Grid_compact()) return false;
+	unsigned nv, ne, nf;
+	Grid_size(&nv, &ne, &nf);
+	if (nv != nb_vertices || ne != nb_edges || nf != nb_facets) return false;
+	for (unsigned i=0; i<nv; i++) if (!Grid_get_vertex(i) || Vertex_name(Grid_get_vertex(i)) != i) return false;
+	for (unsigned i=0; i<ne; i++) if (!Grid_get_edge(i) || Edge_name(Grid_get_edge(i)) != i) return false;
+	for (unsigned i=0; i<nf; i++) if (!Grid_get_facet(i) || Facet_name(Grid_get_facet(i)) != i) return false;
+	return Grid_selection_size(S0) == 2;
+}
+
+static bool check_normals(void) {
+	// a quarter turn around z must turn the cached normals and centers as well
+#	define S2 3
+	unsigned nb_vertices, n = 0;
+	Grid_size(&nb_vertices, NULL, NULL);
+	Vec before[nb_vertices];
+	Grid_update_normals();
+	GridIter it = Grid_iter(GridSel_VERTEX);
+	Vertex *v;
+	while ((v = GridIter_next(&it))) before[n++] = *Vertex_normal(v);
+	Facet *f = Grid_get_facet(0), *g;
+	it = Grid_iter(GridSel_FACET);
+	while ((g = GridIter_next(&it))) {	// the farthest from the axis
+		if (fabs(Vec_coord(Facet_center(g), 0)) > fabs(Vec_coord(Facet_center(f), 0))) f = g;
+	}
+	Vec center = *Facet_center(f);
+	double area = Facet_area(f);
+	Vec origin = { .c = { 0., 0., 0. } }, axis = { .c = { 0., 0., 1. } };
+	if (!Grid_new_selection(S2, GridSel_VERTEX) || !Grid_toggle_selection(S2)) return false;
+	Grid_rotate(S2, &origin, &axis, M_PI/2.);
+	Grid_update_normals();
+	n = 0;
+	it = Grid_iter(GridSel_VERTEX);
+	while ((v = GridIter_next(&it))) {
+		const Vec *after = Vertex_normal(v);
+		if (fabs(Vec_coord(after, 0) + Vec_coord(&before[n], 1)) > 1e-6) return false;
+		if (fabs(Vec_coord(after, 1) - Vec_coord(&before[n], 0)) > 1e-6) return false;
+		if (fabs(Vec_coord(after, 2) - Vec_coord(&before[n], 2)) > 1e-6) return false;
+		n ++;
+	}
+	const Vec *c = Facet_center(f);
+	if (fabs(Vec_coord(c, 0) + Vec_coord(&center, 1)) > 1e-6 || fabs(Vec_coord(c, 1) - Vec_coord(&center, 0)) > 1e-6) return false;
+	if (fabs(Facet_area(f) - area) > 1e-6) return false;
+	Grid_del_selection(S2);
+	return true;
+}
+
+static bool same_direction(const Vec *a, const Vec *b) {
+	Vec ua = *a, ub = *b;
+	Vec_normalize(&ua);
+	Vec_normalize(&ub);
+	return Vec_dist(&ua, &ub) < 1e-6;
+}
+
+static bool check_local_normals(void) {
+	// merging two vertices must outdate the normals around them, although none moved
+	Grid_update_normals();
+	Vertex *v;
+	GridIter it = Grid_iter(GridSel_VERTEX);
+	while ((v = GridIter_next(&it)) && (Vertex_size(v) < 3 || !Vertex_zap(v))) ;
+	if (!v) return false;
+	Facet *f;
+	it = Grid_iter(GridSel_FACET);
+	while ((f = GridIter_next(&it))) {
+		unsigned const size = Facet_size(f);
+		Vec newell = { .c = { 0., 0., 0. } };
+		for (unsigned i=0; i<size; i++) {
+			Vec p, q;
+			Vertex_get_position(Facet_get_vertex(f, i), &p);
+			Vertex_get_position(Facet_get_vertex(f, (i+1)%size), &q);
+			for (unsigned c=0; c<3; c++) {
+				unsigned const c1 = (c+1)%3, c2 = (c+2)%3;
+				newell.c[c] += (p.c[c1] - q.c[c1]) * (p.c[c2] + q.c[c2]);
+			}
+		}
+		if (!same_direction(Facet_normal(f), &newell)) return false;
+	}
+	Edge *e;
+	it = Grid_iter(GridSel_EDGE);
+	while ((e = GridIter_next(&it))) {
+		if (!Edge_get_facet(e, WEST) || !Edge_get_facet(e, EAST)) continue;
+		Vec sum;
+		Vec_add3(&sum, Facet_normal(Edge_get_facet(e, WEST)), Facet_normal(Edge_get_facet(e, EAST)));
+		if (!same_direction(Edge_normal(e), &sum)) return false;
+	}
+	it = Grid_iter(GridSel_VERTEX);
+	while ((v = GridIter_next(&it))) {	// the unit directions toward the neighbours, crossed two by two
+		unsigned const size = Vertex_size(v);
+		if (size < 3) continue;
+		Vec sum = { .c = { 0., 0., 0. } }, prev, cur, cross, p;
+		Vertex_get_position(v, &p);
+		Vec_sub(Vertex_get_position(Vertex_get_vertex(v, 0), &cur), &p);
+		Vec_normalize(&cur);
+		for (unsigned i=1; i<=size; i++) {
+			prev = cur;
+			Vec_sub(Vertex_get_position(Vertex_get_vertex(v, i%size), &cur), &p);
+			Vec_normalize(&cur);
+			Vec_product(&cross, &prev, &cur);
+			Vec_add(&sum, &cross);
+		}
+		if (!same_direction(Vertex_normal(v), &sum)) return false;
+	}
+	return true;
+}
+
+static bool check_queries(void) {
+	// every vertex is on the surface, and so is a point inside any triangle of a facet
+	GridIter it = Grid_iter(GridSel_VERTEX);
+	Vertex *v;
+	while ((v = GridIter_next(&it))) {
+		Vec p, nearest;
+		Vertex_get_position(v, &p);
+		if (!Grid_nearest_facet(&p, &nearest) || Vec_dist(&nearest, &p) > EPSILON) return false;
+	}
+	Vec origin = { .c = { 100., 50., 70. } };
+	it = Grid_iter(GridSel_FACET);
+	Facet *f;
+	while ((f = GridIter_next(&it))) {
+		Vec point, p, dir;
+		Vertex_get_position(Facet_get_vertex(f, 0), &point);
+		Vec_add(&point, Vertex_get_position(Facet_get_vertex(f, 1), &p));
+		Vec_add(&point, Vertex_get_position(Facet_get_vertex(f, 2), &p));
+		Vec_scale(&point, 1./3.);
+		Vec_sub3(&dir, &point, &origin);
+		double dist;
+		if (!Grid_ray_facet(&origin, &dir, &dist) || dist > 1.+EPSILON) return false;
+	}
+	return true;
+}
+
+static bool check_validate(void) {
+	// a facet losing edges breaks f1, e4 for the edges it lost, and v2 around it
+	GridReport report;
+	if (Grid_validate(&report, true)) return false;
+	Facet *f = Grid_get_facet(1);
+	unsigned size = f->size;
+	f->size = 1;
+	unsigned nb = Grid_validate(&report, true);
+	unsigned nb_quick = Grid_validate(&report, false);
+	f->size = size;
+	if (nb != 2*size || nb_quick != 1) return false;
+	if (report.nb_violations[GridRule_F1] != 1 || report.names[GridRule_F1][0] != 1) return false;
+	return Grid_validate(&report, true) == 0;
+}
+
+static bool check_convert(void) {
+	// converting the whole grid builds the incidence tables
+	unsigned nb_vertices, nb_edges, nb_facets;
+	Grid_size(&nb_vertices, &nb_edges, &nb_facets);
+	bool ok =
+		Grid_new_selection(S2, GridSel_VERTEX) && Grid_toggle_selection(S2) &&
+		Grid_convert_selection(S2, GridSel_FACET, GridSel_MIN) && Grid_selection_size(S2) == nb_facets &&
+		Grid_convert_selection(S2, GridSel_EDGE, GridSel_MIN) && Grid_selection_size(S2) == nb_edges &&
+		Grid_convert_selection(S2, GridSel_VERTEX, GridSel_MIN) && Grid_selection_size(S2) == nb_vertices;
+	GridMemStats stats[NB_GRID_MEMS];
+	Grid_memory_stats(stats);
+	// each edge has two vertices, two facets, and is in two vertices and two facets
+	ok = ok && stats[GridMem_INCIDENCE].nb_elmnts == 10*nb_edges;
+	Vertex *v = Grid_get_vertex(0);
+	ok = ok &&
+		Grid_empty_selection(S2) && Grid_addsingle_to_selection(S2, 0) &&
+		Grid_convert_selection(S2, GridSel_FACET, GridSel_MAX) && Grid_selection_size(S2) == Vertex_size(v) &&
+		Grid_convert_selection(S2, GridSel_EDGE, GridSel_MIN) &&
+		Grid_convert_selection(S2, GridSel_FACET, GridSel_MIN) && Grid_selection_size(S2) == Vertex_size(v);
+	Grid_del_selection(S2);
+	return ok;
+}
+
+static bool check_replace(void) {
+	// an element replaced in the selections holding it, and in those only
+#	define S3 4
+	Vertex *v0 = Grid_get_vertex(0), *v1 = Grid_get_vertex(1);
+	bool ok =
+		Grid_new_selection(S2, GridSel_VERTEX) && Grid_addsingle_to_selection(S2, 0) &&
+		Grid_new_selection(S3, GridSel_VERTEX) && Grid_addsingle_to_selection(S3, 2) &&
+		Grid_replace_in_selections(GridSel_VERTEX, v0, v1);
+	ok = ok && Grid_selection_size(S2) == 1 && Grid_selection_size(S3) == 1;
+	Grid_reset_selection(S2);
+	ok = ok && Grid_each_selected(S2) == v1;
+	Grid_reset_selection(S3);
+	ok = ok && Grid_each_selected(S3) == Grid_get_vertex(2);
+	Grid_del_selection(S2);
+	Grid_del_selection(S3);
+	return ok;
+}
+
+static unsigned nb_walked(unsigned name) {
+	unsigned nb = 0;
+	Grid_reset_selection(name);
+	while (Grid_each_selected(name)) nb ++;
+	return nb;
+}
+
+static bool check_zap(unsigned corner) {
+	// a corner of a cube held by several selections is replaced in all of them by its neighbour, which is not zapped in turn
+	if (!Grid_cube(0)) return false;
+	bool ok =
+		Grid_new_selection(S0, GridSel_VERTEX) && Grid_addsingle_to_selection(S0, corner) &&
+		Grid_new_selection(S1, GridSel_VERTEX) && Grid_new_selection(S2, GridSel_EDGE) && Grid_new_selection(S3, GridSel_FACET);
+	for (unsigned i=0; i<12; i++) {
+		ok = ok && (i >= 8 || Grid_addsingle_to_selection(S1, i)) && Grid_addsingle_to_selection(S2, i) && (i >= 6 || Grid_addsingle_to_selection(S3, i));
+	}
+	ok = ok && Grid_zap(S0);
+	unsigned nv, ne, nf;
+	Grid_size(&nv, &ne, &nf);
+	ok = ok && nv == 7 && ne == 11 && nf == 6;
+	ok = ok && Grid_selection_size(S1) == nv && Grid_selection_size(S2) == ne && Grid_selection_size(S3) == nf;
+	for (unsigned s=S0; s<=S3; s++) ok = ok && Grid_selection_size(s) == nb_walked(s);
+	Grid_del();
+	return ok;
+}
+
+static bool check_rings(void) {
+	// each ring is the facets around the previous one, and shrinking takes the outer ones back
+	unsigned rings[1024];
+	bool ok =
+		Grid_new_selection(S2, GridSel_FACET) && Grid_addsingle_to_selection(S2, 0) &&
+		Grid_selection_rings(S2, 2, true, rings, 1024);
+	if (! ok || rings[0] != 0) return false;
+	unsigned nb_ring1 = 0;
+	Facet *f0 = Grid_get_facet(0), *f;
+	Grid_reset_selection(S2);
+	while ( (f = Grid_each_selected(S2)) ) {
+		if (rings[Facet_name(f)] > 2) return false;
+		if (rings[Facet_name(f)] != 1) continue;
+		nb_ring1 ++;
+		// shares a vertex with facet 0
+		bool next = false;
+		for (unsigned i=0; i<Facet_size(f); i++) for (unsigned j=0; j<Facet_size(f0); j++) {
+			next = next || Facet_get_vertex(f, i) == Facet_get_vertex(f0, j);
+		}
+		if (! next) return false;
+	}
+	// facet 0 stays, the rest of the grid being more than two rings away
+	unsigned size = Grid_selection_size(S2);
+	ok = nb_ring1 > 0 && Grid_shrink_selection(S2, 2) && Grid_selection_size(S2) < size;
+	Grid_reset_selection(S2);
+	ok = ok && Grid_each_selected(S2) == f0;
+	Grid_del_selection(S2);
+	return ok;
+}
+
+static bool check_expansion(void) {
+	// a selection moved again after it grew moves its new vertices too
+	Vec up = { .c = { 0., 0., 1. } }, down = { .c = { 0., 0., -1. } };
+	Facet *f0 = Grid_get_facet(0), *f1 = Grid_get_facet(1);
+	Vertex *v = NULL;
+	for (unsigned i=0; i<Facet_size(f1) && !v; i++) {
+		v = Facet_get_vertex(f1, i);
+		for (unsigned j=0; j<Facet_size(f0); j++) if (Facet_get_vertex(f0, j) == v) v = NULL;
+	}
+	if (! v) return false;
+	Vec p;
+	double z = Vertex_get_position(v, &p)->c[2];
+	bool ok = Grid_new_selection(S2, GridSel_FACET) && Grid_addsingle_to_selection(S2, 0);
+	Grid_translate(S2, &up, 1.);
+	ok = ok && Vertex_get_position(v, &p)->c[2] == z && Grid_addsingle_to_selection(S2, 1);
+	Grid_translate(S2, &up, 1.);
+	ok = ok && fabs(Vertex_get_position(v, &p)->c[2] - (z+1.)) < EPSILON;
+	Grid_translate(S2, &down, 1.);
+	ok = ok && Grid_subsingle_from_selection(S2, 1);
+	Grid_translate(S2, &down, 1.);
+	ok = ok && fabs(Vertex_get_position(v, &p)->c[2] - z) < EPSILON;
+	Grid_del_selection(S2);
+	return ok;
+}
+
+static int nb_selected_as_expected(unsigned name, GridSel_type t, bool (*expect)(GridSel_type, void *, const void *), const void *data) {
+	// the number of elements of type t selected in name, or -1 if they are not those expect tells, one by one
+	int nb_in = 0;
+	GridIter it = Grid_iter(t);
+	void *elmnt;
+	while ((elmnt = GridIter_next(&it))) {
+		bool in = expect(t, elmnt, data);
+		if (in != Grid_selected(name, elmnt)) return -1;
+		nb_in += in;
+	}
+	return nb_in;
+}
+
+struct region {
+	enum { BOX, SPHERE, HALFSPACE, CYLINDER } type;
+	Vec a, b;	// as for the BVH regions
+	double radius;
+};
+
+static bool in_region(const struct region *r, Vertex *v) {
+	Vec p, d, axis;
+	double t;
+	Vertex_get_position(v, &p);
+	Vec_sub3(&d, &p, &r->a);
+	switch (r->type) {
+		case BOX:
+			for (unsigned a=0; a<3; a++) {
+				if (p.c[a] < r->a.c[a] || p.c[a] > r->b.c[a]) return false;
+			}
+			return true;
+		case SPHERE:
+			return Vec_norm2(&d) <= r->radius*r->radius;
+		case HALFSPACE:
+			return Vec_scalar(&d, &r->b) >= 0.;
+		case CYLINDER:
+			break;
+	}
+	Vec_sub3(&axis, &r->b, &r->a);
+	t = Vec_norm2(&axis) > 0. ? Vec_scalar(&d, &axis) / Vec_norm2(&axis) : 0.;
+	if (t < 0. || t > 1.) return false;
+	Vec_add_scale(&d, -t, &axis);
+	return Vec_norm2(&d) <= r->radius*r->radius;
+}
+
+static bool expect_in_region(GridSel_type t, void *elmnt, const void *data) {
+	// all the vertices of the element
+	if (t == GridSel_VERTEX) return in_region(data, elmnt);
+	if (t == GridSel_EDGE) return in_region(data, Edge_get_vertex(elmnt, SOUTH)) && in_region(data, Edge_get_vertex(elmnt, NORTH));
+	bool in = true;
+	for (unsigned i=0; i<Facet_size(elmnt); i++) in = in && in_region(data, Facet_get_vertex(elmnt, i));
+	return in;
+}
+
+static bool check_select_in(void) {
+	// the same elements as when testing all of them, around the center, then with a vertex on the boundary
+	Vec c = { .c = { 0., 0., 0. } };
+	unsigned nb_all[3];
+	Grid_size(nb_all+GridSel_VERTEX, nb_all+GridSel_EDGE, nb_all+GridSel_FACET);
+	GridIter it = Grid_iter(GridSel_VERTEX);
+	Vertex *v, *v0 = GridIter_next(&it);
+	Vec p;
+	for (v = v0; v; v = GridIter_next(&it)) Vec_add(&c, Vertex_get_position(v, &p));
+	Vec_scale(&c, 1./nb_all[GridSel_VERTEX]);
+	Vertex_get_position(v0, &p);
+	Vec x = { .c = { 1., 0., 0. } }, z = { .c = { 0., 0., 1. } }, normal = { .c = { 1., 1., 0. } };
+	struct region regions[] = {
+		{ .type = BOX, .a = c, .b = c },
+		{ .type = SPHERE, .a = c, .radius = 1.17 },
+		{ .type = HALFSPACE, .a = c, .b = normal },
+		{ .type = CYLINDER, .a = c, .b = c, .radius = .87 },
+		{ .type = BOX, .a = p, .b = p },
+		{ .type = BOX, .a = p, .b = p },
+		{ .type = SPHERE, .a = p, .radius = 0. },
+		{ .type = HALFSPACE, .a = p, .b = x },
+		{ .type = CYLINDER, .a = p, .b = p, .radius = 0. },
+		{ .type = CYLINDER, .a = p, .b = p, .radius = 0. },
+	};
+#	define NB_AROUND 4
+	for (unsigned a=0; a<3; a++) regions[0].a.c[a] -= .93, regions[0].b.c[a] += .93;
+	regions[2].a.c[0] += .013;
+	regions[3].a.c[2] -= .91;
+	regions[3].b.c[2] += .91;
+	for (unsigned a=0; a<3; a++) regions[4].b.c[a] += 1., regions[5].a.c[a] -= 1.;
+	Vec_add(&regions[8].b, &z);
+	Vec_sub(&regions[9].a, &z);
+	for (unsigned r=0; r<sizeof(regions)/sizeof(*regions); r++) for (GridSel_type t=GridSel_VERTEX; t<=GridSel_FACET; t++) {
+		const struct region *region = regions+r;
+		if (! Grid_new_selection(S2, t)) return false;
+		bool ok =
+			region->type == BOX ? Grid_select_in_box(S2, &region->a, &region->b) :
+			region->type == SPHERE ? Grid_select_in_sphere(S2, &region->a, region->radius) :
+			region->type == HALFSPACE ? Grid_select_in_halfspace(S2, &region->a, &region->b) :
+			Grid_select_in_cylinder(S2, &region->a, &region->b, region->radius);
+		int nb_in = ok ? nb_selected_as_expected(S2, t, expect_in_region, region) : -1;
+		// some, but not all, and the vertex on the boundary is in
+		ok = r < NB_AROUND ? nb_in > 0 && (unsigned)nb_in < nb_all[t] : nb_in >= 0 && (t != GridSel_VERTEX || Grid_selected(S2, v0));
+		Grid_del_selection(S2);
+		if (! ok) return false;
+	}
+	return true;
+}
+
+struct predicate {
+	enum { NORMAL, LONGER, COLOR, UV, BASIS } type;
+	Vec axis;
+	double value;
+};
+
+static bool expect_predicate(GridSel_type t, void *elmnt, const void *data) {
+	const struct predicate *p = data;
+	const Vec *n;
+	(void)t;
+	switch (p->type) {
+		case NORMAL:
+			n = Facet_normal(elmnt);
+			return Vec_scalar(n, &p->axis) >= cos(p->value) * Vec_norm(n) && Vec_norm(n) > 0.;
+		case LONGER:
+			return Edge_length(elmnt) > p->value;
+		case COLOR:
+			return Vertex_color(elmnt) == 1;
+		case UV:
+			return Vertex_uv_x(elmnt) >= .2 && Vertex_uv_x(elmnt) <= .4 && Vertex_uv_y(elmnt) >= .6 && Vertex_uv_y(elmnt) <= .8;
+		case BASIS:
+			break;
+	}
+	return Vertex_basis(elmnt) == 0;
+}
+
+static bool select_predicate(unsigned name, const struct predicate *p) {
+	switch (p->type) {
+		case NORMAL:
+			return Grid_select_by_normal(name, &p->axis, p->value);
+		case LONGER:
+			return Grid_select_by_length(name, p->value, true);
+		case COLOR:
+			return Grid_select_by_color(name, 1);
+		case UV:
+			return Grid_select_by_uv(name, .2, .6, .4, .8);
+		case BASIS:
+			break;
+	}
+	return Grid_select_by_basis(name, 0);
+}
+
+static bool check_select_if(void) {
+	// the same elements as when testing all of them
+	struct predicate preds[] = {
+		{ .type = NORMAL, .axis = { .c = { 0., 0., 1. } }, .value = .5 },
+		{ .type = LONGER },
+		{ .type = COLOR },
+		{ .type = UV },
+		{ .type = BASIS },
+	};
+	unsigned nb_edges;
+	Grid_size(NULL, &nb_edges, NULL);
+	GridIter it = Grid_iter(GridSel_EDGE);
+	Edge *e;
+	while ((e = GridIter_next(&it))) preds[1].value += Edge_length(e);
+	preds[1].value /= nb_edges;
+	if (! Grid_new_color(1, 1., 0., 0.) || ! Grid_set_selection_color(S0, 1) || ! Grid_set_uv(S0, .3, .7)) return false;
+	for (unsigned p=0; p<sizeof(preds)/sizeof(*preds); p++) {
+		GridSel_type t = preds[p].type == NORMAL ? GridSel_FACET : preds[p].type == LONGER ? GridSel_EDGE : GridSel_VERTEX;
+		if (! Grid_new_selection(S2, t)) return false;
+		int nb_in = select_predicate(S2, preds+p) ? nb_selected_as_expected(S2, t, expect_predicate, preds+p) : -1;
+		Grid_del_selection(S2);
+		if (nb_in <= 0) return false;
+	}
+	Grid_set_selection_color(S0, 0);
+	Grid_del_color(1);
+	return true;
+}
+
+static bool check_select_if_split(void) {
+	// enough vertices to share them between two threads, with the last word of names not full
+	const unsigned nb_vertices = 2*4096 + 37;
+	if (! Grid_new()) return false;
+	bool ok = true;
+	for (unsigned i=0; ok && i<nb_vertices; i++) {
+		Vec pos = { .c = { i, 0., 0. } };
+		ok = NULL != Grid_vertex_new(&pos, 0, 0., i%3 ? .1 : .3, .7);
+	}
+	// added to what was already selected, on both sides of the split
+	ok = ok && Grid_new_selection(S2, GridSel_VERTEX) &&
+		Grid_addsingle_to_selection(S2, 1) && Grid_addsingle_to_selection(S2, 4096+1) &&
+		Grid_select_by_uv(S2, .2, .6, .4, .8) &&
+		Grid_selection_size(S2) == (nb_vertices+2)/3 + 2;
+	GridIter it = Grid_iter(GridSel_VERTEX);
+	Vertex *v;
+	while (ok && (v = GridIter_next(&it))) {
+		unsigned name = Vertex_name(v);
+		ok = Grid_selected(S2, v) == (name%3 == 0 || name == 1 || name == 4096+1);
+	}
+	Grid_del();
+	return ok;
+}
+
+static bool check_added_facets(void) {
+	// facets added after the tree was built are found aside, then in the tree once there are enough to build it again
+	unsigned nb_facets, nf;
+	Grid_size(NULL, NULL, &nb_facets);
+	if (!check_queries() || !Grid_new_selection(S3, GridSel_FACET)) return false;
+	bool ok = true;
+	unsigned f = 0;
+	do {
+		ok = Grid_empty_selection(S3) && Grid_addsingle_to_selection(S3, f++) && Grid_extrude(S3, false, NULL, .5, NONE);
+		Grid_size(NULL, NULL, &nf);
+		ok = ok && check_queries() && check_select_in();
+	} while (ok && 4*(nf - nb_facets) <= nb_facets + 64);
+	Grid_del_selection(S3);
+	return ok;
+}
+
+static bool check_memory(void) {
+	GridMemStats stats[NB_GRID_MEMS];
+	Grid_memory_stats(stats);
+	unsigned nb_vertices, nb_edges, nb_facets;
+	Grid_size(&nb_vertices, &nb_edges, &nb_facets);
+	if (stats[GridMem_VERTICES].nb_elmnts != nb_vertices || stats[GridMem_EDGES].nb_elmnts != nb_edges || stats[GridMem_FACETS].nb_elmnts != nb_facets) return false;
+	if (stats[GridMem_EDGE_INDEX].nb_elmnts != nb_edges) return false;
+	for (GridMem m=0; m<GridMem_SELECTIONS; m++) {
+		if (stats[m].used > stats[m].bytes || stats[m].nb_elmnts > stats[m].capacity || stats[m].high_water < stats[m].bytes) return false;
+	}
+	// taking stats in the middle of a walk over the selections must not restart it
+	if (!Grid_new_selection(101, GridSel_VERTEX) || !Grid_new_selection(102, GridSel_EDGE)) return false;
+	unsigned nb_selections = 0, nb_walked = 0;
+	Grid_reset_selections();
+	while (Grid_each_selection()) nb_selections ++;
+	Grid_reset_selections();
+	while (Grid_each_selection()) {
+		if (++nb_walked == 1) Grid_memory_stats(NULL);
+	}
+	Grid_del_selection(101);
+	Grid_del_selection(102);
+	return nb_walked == nb_selections;
+}
+
 int main(void) {
 	int ret = EXIT_FAILURE;
 	if (!cnt_init(1024, LOG_DEBUG)) return ret;
 	atexit(cnt_end);
+	if (!build_pantin() || !check_iterators() || !check_validate() || !check_convert() || !check_replace() || !check_rings() || !check_expansion() || !check_select_in() || !check_select_if() || !check_memory() || !check_queries() || !check_normals() || !check_queries()) goto exit;
+	// build it again in the same memory
+	unsigned nb_vertices, nb_edges, nb_facets;
+	Grid_size(&nb_vertices, &nb_edges, &nb_facets);
+	if (!Grid_clear() || !build_pantin()) goto exit;
+	unsigned nv, ne, nf;
+	Grid_size(&nv, &ne, &nf);
+	Grid_del();
+	if (nv != nb_vertices || ne != nb_edges || nf != nb_facets) goto exit;
 	if (!build_pantin()) goto exit;
+	bool ok = check_half_edges() && check_compact() && check_added_facets() && check_half_edges() && check_local_normals() && check_half_edges();
 	Grid_del();
+	if (!ok || !check_select_if_split() || !check_zap(0) || !check_zap(7)) goto exit;
 	ret = EXIT_SUCCESS;
 exit:
 	return ret;
@@ -30,17 +30,23 @@ Facet *Edge_get_facet(const Edge *this, EdgeSide side);
 Vertex *Edge_get_vertex(const Edge *this, EdgePole pole);
 
 const Vec *Edge_normal(Edge *this);
+void Edge_invalidate_normal(Edge *this);
 double Edge_length(Edge *this);
 
 #include <stdbool.h>
 
+typedef struct EdgeAttr {	// what is seldom used, kept in a column of the grid
+	Vec normal;
+	unsigned normal_gen;	// normal is valid if equal to the grid normals generation
+} EdgeAttr;
+
 struct Edge {
 	unsigned name;
 	Vertex *v[2];
 	Facet *facets[2];	// WEST, EAST
-	Vec normal;
-	bool normal_ok;
-};
+};	// the attributes are in a column of the grid, by name
+
+EdgeAttr *Edge_attr(const Edge *this);	// until the next edge is created
 
 int Edge_construct(Edge *this, unsigned name, Vertex *v1, Vertex *v2);
 int Edge_destruct(Edge *this);
@@ -52,6 +58,7 @@ void Edge_set_vertex(Edge *this, EdgePole pole, Vertex *new);
 void Edge_cut(Edge *this, Edge *new, Vertex *v);
 bool edges_are_connected(Edge *e0, Edge *e1);
 void Edge_zap(Edge *this);
+void Edge_relocate(Edge *this, Vertex *const *vertices, Facet *const *facets);
 
 #include <assert.h>
 static inline unsigned Edge_name(Edge *this) {
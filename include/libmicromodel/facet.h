@@ -34,16 +34,25 @@ Facet *Facet_get_facet(const Facet *this, unsigned order);
 const Vec *Facet_normal(Facet *this);
 void Facet_invalidate_normal(Facet *this);
 const Vec *Facet_center(Facet *this);
+double Facet_area(Facet *this);
 
 #include <stdbool.h>
 
+typedef struct FacetAttr {	// what is seldom used, kept in a column of the grid
+	unsigned capacity;	// of facetEdges
+	Vec normal;
+	Vec center;	// average of the vertices
+	double area;
+	unsigned normal_gen;	// normal, center and area are valid if equal to the grid normals generation
+} FacetAttr;
+
 struct Facet {
 	unsigned size;
 	unsigned name;
-	Vec normal;
-	bool normal_ok;
-	struct FacetEdge *first_facetEdge;
-};
+	struct FacetEdge *facetEdges;	// size edges in direct order, capacity allocated
+};	// the attributes are in a column of the grid, by name
+
+FacetAttr *Facet_attr(const Facet *this);	// until the next facet is created
 
 int Facet_construct(Facet *this, unsigned name, unsigned size, Edge **edges, bool direct);
 int Facet_destruct(Facet *this);
@@ -55,6 +64,7 @@ int Facet_remove_if_flat(Facet *this);
 void Facet_remove_edge(Facet *this, Edge *edge);
 EdgeSide Facet_my_side(const Facet *this, Edge *edge);
 void Facet_swallow_by_edge(Facet *this, Edge *edge);
+void Facet_relocate(Facet *this, Edge *const *edges);
 
 #include <assert.h>
 static inline unsigned Facet_name(Facet *this) {
@@ -24,11 +24,43 @@ typedef struct GridSel GridSel;
 typedef enum { GridSel_VERTEX=0, GridSel_EDGE, GridSel_FACET } GridSel_type;
 typedef enum { GridSel_MIN=0, GridSel_MAX } GridSel_convert_type;
 typedef enum { GridSel_PLANAR, GridSel_CYLINDRIC, GridSel_SPHERICAL } GridSel_mapping_type;
+typedef enum {	// topology invariants, see lib/rules.c
+	GridRule_V1=0, GridRule_V2, GridRule_V3,
+	GridRule_E1, GridRule_E2, GridRule_E3, GridRule_E4,
+	GridRule_F1, GridRule_F2, GridRule_F3,
+	NB_GRID_RULES
+} GridRule;
+
+#define GRID_REPORT_NAMES 8
+typedef struct GridReport {
+	unsigned nb_violations[NB_GRID_RULES];
+	unsigned names[NB_GRID_RULES][GRID_REPORT_NAMES];	// of the first elements breaking each rule
+} GridReport;
+
+typedef enum {	// what uses memory in a grid
+	GridMem_VERTICES=0, GridMem_EDGES, GridMem_FACETS,	// element tables
+	GridMem_CONNECTIONS,	// vertexEdges, facetEdges and attributes
+	GridMem_EDGE_INDEX, GridMem_NORMALS, GridMem_BVH, GridMem_HALF_EDGES, GridMem_INCIDENCE,
+	GridMem_SELECTIONS,
+	NB_GRID_MEMS
+} GridMem;
+
+#include <stddef.h>
+typedef struct GridMemStats {
+	size_t bytes;	// allocated
+	size_t used;	// of which in use, the rest being free slots or spare room
+	unsigned nb_elmnts;
+	unsigned capacity;	// elements that fit in the allocated bytes
+	size_t high_water;	// most bytes allocated since the grid was created
+} GridMemStats;
 
 #include <stdbool.h>
 #include <libcnt/vec.h>
 
+// All functions work on the current grid, which is per thread (see Grid_set).
+// The carac size below is also per thread.
 int Grid_new(void);
+int Grid_clear(void);
 void Grid_del(void);
 void Grid_set(Grid *this);
 Grid *Grid_get(void);
@@ -45,6 +77,11 @@ int Grid_triangle(unsigned name);
 int Grid_square(unsigned name);
 
 void Grid_size(unsigned *nb_vertices, unsigned *nb_edges, unsigned *nb_facets);
+void Grid_update_normals(void);
+unsigned Grid_validate(GridReport *report, bool thorough);
+const char *Grid_rule_description(GridRule rule);
+void Grid_memory_stats(GridMemStats stats[NB_GRID_MEMS]);
+const char *Grid_memory_name(GridMem mem);
 
 void Grid_scale(unsigned selection, Vec *center, double ratio);
 void Grid_stretch(unsigned selection, Vec *center, Vec *axis, double ratio);
@@ -63,6 +100,7 @@ int Grid_zap(unsigned selection);
 int Grid_plane_cut(unsigned selection, unsigned result_selection, Vec *center, Vec *normal);
 int Grid_separate(unsigned selection, unsigned result_selection); 
 int Grid_mirror(unsigned selection, unsigned result_selection);
+int Grid_compact(void);
 
 int Grid_new_selection(unsigned name, GridSel_type type);
 int Grid_del_selection(unsigned name);
@@ -74,7 +112,25 @@ int Grid_add_to_selection(unsigned name_dest, unsigned name_src);
 int Grid_sub_from_selection(unsigned name_dest, unsigned name_src);
 int Grid_convert_selection(unsigned name, GridSel_type type, GridSel_convert_type convert_type);
 int Grid_propagate_selection(unsigned name, unsigned level);
+int Grid_shrink_selection(unsigned name, unsigned level);
+// Propagate (or shrink) the selection, rings gets by element name the ring that brought each
+// element in (or out), 0 for those already on that side, UINT_MAX for the others
+int Grid_selection_rings(unsigned name, unsigned level, bool grow, unsigned *rings, unsigned nb_names);
 int Grid_replace_in_selections(GridSel_type type, void *old_elmnt, void *new_elmnt);
+// Add to the selection the elements which vertices are all in the region. The halfspace is on
+// the side the normal points to, the cylinder goes from base to top.
+int Grid_select_in_box(unsigned name, const Vec *min, const Vec *max);
+int Grid_select_in_sphere(unsigned name, const Vec *center, double radius);
+int Grid_select_in_halfspace(unsigned name, const Vec *point, const Vec *normal);
+int Grid_select_in_cylinder(unsigned name, const Vec *base, const Vec *top, double radius);
+// Add to the selection the facets which normal is within angle (in radians) of axis, the vertices
+// of a color, a basis or within a uv rectangle, or the edges longer or shorter than length.
+// They are converted to the type of the selection.
+int Grid_select_by_normal(unsigned name, const Vec *axis, double angle);
+int Grid_select_by_color(unsigned name, unsigned color);
+int Grid_select_by_basis(unsigned name, unsigned basis);
+int Grid_select_by_uv(unsigned name, float min_u, float min_v, float max_u, float max_v);
+int Grid_select_by_length(unsigned name, double length, bool longer);
 
 int Grid_new_basis(unsigned name, unsigned father, Vec *position, Vec *x, Vec *y, Vec *z);
 int Grid_del_basis(unsigned name);
@@ -96,6 +152,7 @@ int Grid_set_selection_color(unsigned selection, unsigned color);
 #include <libmicromodel/vertex.h>
 #include <libmicromodel/basis.h>
 #include <libmicromodel/color.h>
+#include <libmicromodel/halfedge.h>
 
 Edge *Grid_edge_cut(Edge *edge, double ratio);
 void Grid_replace_vertex(Vertex *v, Vertex *rep);
@@ -105,6 +162,8 @@ Facet *Grid_get_facet(unsigned index);
 Edge *Grid_get_edge(unsigned index);
 Edge *Grid_edge_index_from_vertices(Vertex *v1, Vertex *v2);
 Vertex *Grid_get_vertex(unsigned index);
+Facet *Grid_ray_facet(const Vec *origin, const Vec *dir, double *dist);
+Facet *Grid_nearest_facet(const Vec *point, Vec *nearest);
 void Grid_reset_vertices(void);
 Vertex *Grid_each_vertex(void);
 void Grid_reset_facets(void);
@@ -115,6 +174,7 @@ void Grid_reset_selections(void);
 unsigned Grid_each_selection(void);
 bool Grid_selected(unsigned name, void *elmnt);
 unsigned Grid_selection_size(unsigned name);
+// Selected elements come by increasing names, whatever the order they were selected in.
 void Grid_reset_selection(unsigned name);
 void *Grid_each_selected(unsigned name);
 GridSel_type Grid_get_selection_type(unsigned name);
@@ -127,6 +187,20 @@ const Vec *Grid_basis_center(unsigned name);
 Color *Grid_get_color(unsigned name);
 void Grid_reset_colors(void);
 unsigned Grid_each_color(void);
+const HalfEdges *Grid_half_edge_view(void);
+
+// Iterators are plain values : they can be copied, nested, or split in ranges
+// (for instance one per thread). Elements come by increasing names.
+struct ElmntTable;
+typedef struct GridIter {
+	const struct ElmntTable *table;
+	unsigned next, end;	// names still to visit
+	GridSel *sel;	// if not NULL, only elements of this selection
+} GridIter;
+GridIter Grid_iter(GridSel_type type);
+GridIter Grid_iter_selection(unsigned name);
+GridIter GridIter_split(const GridIter *this, unsigned nb_parts, unsigned part);
+void *GridIter_next(GridIter *this);
 
 Vertex *Grid_vertex_new(const Vec *position, unsigned bi, float ratio, float uv_x, float uv_y);
 Vertex *Grid_vertex_average_new(const Vertex *v1, const Vertex *v2, double ratio);
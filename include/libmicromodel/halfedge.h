@@ -0,0 +1,83 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef HALFEDGE_H_060305
+#define HALFEDGE_H_060305
+
+/* Index based view of the grid topology, as flat tables of half-edges.
+ * Elements are numbered densely, by increasing names (as Grid_iter gives them).
+ * Built on demand by Grid_half_edge_view, and rebuilt once the topology changed.
+ * This is a copy for the exporters, on top of the element storage: it costs
+ * memory while it is kept, and nothing else uses it.
+ * Edge e gives half-edges 2e (from its SOUTH to its NORTH, facet WEST)
+ * and 2e+1 (from NORTH to SOUTH, facet EAST), so that the twin of h is h^1.
+ */
+
+typedef struct HalfEdges HalfEdges;
+
+#include <stdint.h>
+#include <libmicromodel/vertex.h>
+#include <libmicromodel/edge.h>
+#include <libmicromodel/facet.h>
+#include <libmicromodel/grid.h>
+
+#define HALFEDGE_NONE UINT32_MAX
+
+struct HalfEdges {
+	unsigned version;	// topology version of the grid these tables were build from
+	uint32_t nb_vertices, nb_edges, nb_facets;
+	uint32_t max_vertices, max_edges, max_facets;	// allocated
+	// per half-edge
+	uint32_t *next;	// next half-edge around the facet, HALFEDGE_NONE on borders
+	uint32_t *vertex;	// origin vertex
+	uint32_t *facet;	// facet on the left, or HALFEDGE_NONE
+	// per vertex and facet
+	uint32_t *vertex_half;	// half-edge leaving the vertex along its first connection
+	uint32_t *facet_half;	// half-edge along the first edge of the facet
+	// back to the elements
+	Vertex **vertices;
+	Edge **edges;
+	Facet **facets;
+};
+
+int HalfEdges_construct(HalfEdges *this);
+void HalfEdges_destruct(HalfEdges *this);
+int HalfEdges_build(HalfEdges *this, unsigned version);
+void HalfEdges_stats(const HalfEdges *this, GridMemStats *stats);
+
+#include <assert.h>
+static inline uint32_t HalfEdges_twin(uint32_t h) {
+	return h^1;
+}
+static inline uint32_t HalfEdges_next(const HalfEdges *this, uint32_t h) {
+	assert(this && h < 2*this->nb_edges);
+	return this->next[h];
+}
+static inline uint32_t HalfEdges_vertex(const HalfEdges *this, uint32_t h) {
+	assert(this && h < 2*this->nb_edges);
+	return this->vertex[h];
+}
+static inline uint32_t HalfEdges_facet(const HalfEdges *this, uint32_t h) {
+	assert(this && h < 2*this->nb_edges);
+	return this->facet[h];
+}
+static inline uint32_t HalfEdges_edge(uint32_t h) {
+	return h>>1;
+}
+
+#endif
+// vi:ts=3:sw=3
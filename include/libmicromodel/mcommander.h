@@ -24,7 +24,8 @@
 
 /* Pour piloter Grid */
 
-void MCom_reset(void);
+void MCom_reset(void);	// also frees this thread's interpreter state
+void MCom_reuse(void);	// same, but keeps the grid memory for the next evaluation
 int MCom_begin(unsigned char command);
 int MCom_param_backref(unsigned char backref);	// replace a grid, a vec, a real or a sel
 int MCom_param_vec(float x, float y, float z);
@@ -38,6 +39,16 @@ int MCom_end(void);
 int MCom_binexec(unsigned char *bin, unsigned max_size, unsigned *read_size);
 unsigned MCom_binexec_all(unsigned char *bin, unsigned bin_size);
 
+typedef enum {	// checking the grid after each command
+	MCom_VALIDATE_NONE=0,
+	MCom_VALIDATE_QUICK,	// only the rules that do not search rings
+	MCom_VALIDATE_THOROUGH
+} MCom_validation;
+void MCom_set_validation(MCom_validation v);
+#include <stdbool.h>
+void MCom_set_memory_stats(bool on);
+void MCom_log_memory_stats(void);
+
 /* Pour piloter le modeleur */
 
 typedef enum {
@@ -42,21 +42,24 @@ int Vertex_zap(Vertex *this);
 
 typedef struct VertexEdge {
 	Edge *edge;
-	struct VertexEdge *next;
+	EdgePole pole;	// our pole on this edge
 } VertexEdge;
 
-struct Vertex {
-	unsigned name;
-	unsigned size;
-	Vec position;
+typedef struct VertexAttr {	// what is seldom used, kept in a column of the grid
 	unsigned basis;
 	unsigned color;
 	float skin_ratio;	// 0 -> fully in basis, 1 -> fully in basis' father
 	float uv_x, uv_y;	// mapping coordinates in the range [-1,1] (when not looping)
+	unsigned capacity;	// of vertexEdges
 	Vec normal;
-	bool normal_ok;
-	VertexEdge *first_vertexEdge;
-};
+	unsigned normal_gen;	// normal is valid if equal to the grid normals generation
+} VertexAttr;
+
+struct Vertex {
+	unsigned name;
+	unsigned size;
+	VertexEdge *vertexEdges;	// size connections, ordered around the vertex
+};	// the position and the attributes are in columns of the grid, by name
 
 int Vertex_construct(Vertex *this, unsigned name, const Vec *position, unsigned basis, float skin_ratio, float uv_x, float uv_y);
 int Vertex_destruct(Vertex *this);
@@ -67,36 +70,38 @@ void Vertex_add_edge(Vertex *this, Edge *edge);
 void Vertex_change_connection(Vertex *this, Edge *old, Edge *new);
 void Vertex_move_connections(Vertex *this, Vertex *dest, Edge *from, Edge *to);
 void Vertex_remove_connection(Vertex *this, Edge *edge);
+void Vertex_relocate(Vertex *this, Edge *const *edges);
+Vec *Vertex_get_position(const Vertex *this, Vec *position);	// copied into position, which is returned
+void Vertex_set_position(Vertex *this, const Vec *position);
+VertexAttr *Vertex_attr(const Vertex *this);	// until the next vertex is created
 const Vec *Vertex_normal(Vertex *this);
+void Vertex_invalidate_normal(Vertex *this);
+void Vertex_moved(Vertex *this);
 
 #include <assert.h>
 static inline unsigned Vertex_basis(Vertex *this) {
 	assert(this);
-	return this->basis;
+	return Vertex_attr(this)->basis;
 }
 static inline float Vertex_skin_ratio(Vertex *this) {
 	assert(this);
-	return this->skin_ratio;
-}
-static inline Vec *Vertex_position(Vertex *this) {
-	assert(this);
-	return &this->position;
+	return Vertex_attr(this)->skin_ratio;
 }
 static inline unsigned Vertex_color(Vertex *this) {
 	assert(this);
-	return this->color;
+	return Vertex_attr(this)->color;
 }
 static inline float Vertex_uv_x(Vertex *this) {
 	assert(this);
-	return this->uv_x;
+	return Vertex_attr(this)->uv_x;
 }
 static inline float Vertex_uv_y(Vertex *this) {
 	assert(this);
-	return this->uv_y;
+	return Vertex_attr(this)->uv_y;
 }
 static inline void Vertex_set_color(Vertex *this, unsigned color) {
 	assert(this);
-	this->color = color;
+	Vertex_attr(this)->color = color;
 }
 static inline unsigned Vertex_name(Vertex *this) {
 	assert(this);
@@ -104,8 +109,8 @@ static inline unsigned Vertex_name(Vertex *this) {
 }
 static inline void Vertex_set_uv_mapping(Vertex *this, float uv_x, float uv_y) {
 	assert(this);
-	this->uv_x = uv_x;
-	this->uv_y = uv_y;
+	Vertex_attr(this)->uv_x = uv_x;
+	Vertex_attr(this)->uv_y = uv_y;
 }
 
 #endif
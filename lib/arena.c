@@ -0,0 +1,165 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "../config.h"
+#include <assert.h>
+#include <string.h>
+#include <libcnt/mem.h>
+#include "arena.h"
+
+/* Private Functions */
+
+static unsigned size_class(size_t size) {
+	unsigned c = 0;
+	size_t s = ARENA_MIN_BLOCK;
+	while (s < size) s <<= 1, c++;
+	assert(c < ARENA_NB_CLASSES);
+	return c;
+}
+
+static size_t class_size(unsigned c) {
+	return (size_t)ARENA_MIN_BLOCK << c;
+}
+
+static int grow(void ***array, unsigned *max) {
+	unsigned new_max = *max ? 2 * *max : 8;
+	void **tmp = *array ? mem_realloc(*array, new_max*sizeof(*tmp)) : mem_alloc(new_max*sizeof(*tmp));
+	if (!tmp) return 0;
+	*array = tmp;
+	*max = new_max;
+	return 1;
+}
+
+static void *Arena_large(Arena *this, size_t size) {
+	if (this->nb_large == this->max_large && !grow(&this->large, &this->max_large)) return NULL;
+	void *block = mem_alloc(size);
+	if (! block) return NULL;
+	this->large[this->nb_large++] = block;
+	this->large_bytes += size;
+	return block;
+}
+
+static void *Arena_carve(Arena *this, size_t size) {
+	if (!this->nb_used_chunks || this->used + size > this->chunk_size) {
+		if (this->nb_used_chunks == this->nb_chunks) {
+			if (this->nb_chunks == this->max_chunks && !grow(&this->chunks, &this->max_chunks)) return NULL;
+			void *chunk = mem_alloc(this->chunk_size);
+			if (!chunk) return NULL;
+			this->chunks[this->nb_chunks++] = chunk;
+		}
+		this->nb_used_chunks ++;
+		this->used = 0;
+	}
+	void *block = (char *)this->chunks[this->nb_used_chunks-1] + this->used;
+	this->used += size;
+	return block;
+}
+
+/* Public Functions */
+
+void Arena_construct(Arena *this, size_t chunk_size) {
+	assert(this && chunk_size >= ARENA_MIN_BLOCK);
+	this->chunk_size = chunk_size;
+	this->nb_chunks = this->max_chunks = this->nb_used_chunks = 0;
+	this->chunks = NULL;
+	this->used = 0;
+	this->nb_large = this->max_large = 0;
+	this->large = NULL;
+	for (unsigned c=0; c<ARENA_NB_CLASSES; c++) this->free_blocks[c] = NULL;
+	this->nb_blocks = 0;
+	this->large_bytes = 0;
+}
+
+void Arena_destruct(Arena *this) {
+	assert(this);
+	Arena_clear(this);
+	for (unsigned c=0; c<this->nb_chunks; c++) {
+		mem_unregister(this->chunks[c]);
+	}
+	if (this->chunks) mem_unregister(this->chunks);
+	if (this->large) mem_unregister(this->large);
+	Arena_construct(this, this->chunk_size);
+}
+
+void Arena_clear(Arena *this) {
+	// forget all blocks, but keep the chunks
+	assert(this);
+	for (unsigned l=0; l<this->nb_large; l++) {
+		mem_unregister(this->large[l]);
+	}
+	this->nb_large = 0;
+	this->nb_used_chunks = 0;
+	this->used = 0;
+	for (unsigned c=0; c<ARENA_NB_CLASSES; c++) this->free_blocks[c] = NULL;
+	this->nb_blocks = 0;
+	this->large_bytes = 0;
+}
+
+void *Arena_alloc(Arena *this, size_t size) {
+	assert(this && size > 0);
+	unsigned c = size_class(size);
+	void *block = this->free_blocks[c];
+	if (block) {
+		this->free_blocks[c] = *(void **)block;
+	} else {
+		size = class_size(c);
+		block = size > this->chunk_size/4 ? Arena_large(this, size) : Arena_carve(this, size);
+	}
+	if (block) this->nb_blocks ++;
+	return block;
+}
+
+void *Arena_realloc(Arena *this, void *ptr, size_t old_size, size_t new_size) {
+	assert(this);
+	if (!ptr) return Arena_alloc(this, new_size);
+	if (size_class(old_size) == size_class(new_size)) return ptr;
+	void *block = Arena_alloc(this, new_size);
+	if (!block) return NULL;
+	memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+	Arena_free(this, ptr, old_size);
+	return block;
+}
+
+void Arena_free(Arena *this, void *ptr, size_t size) {
+	// the block is kept for the same size class
+	assert(this && ptr);
+	unsigned c = size_class(size);
+	*(void **)ptr = this->free_blocks[c];
+	this->free_blocks[c] = ptr;
+	assert(this->nb_blocks > 0);
+	this->nb_blocks --;
+}
+
+void Arena_stats(const Arena *this, GridMemStats *stats) {
+	// the free blocks are counted, so this is not for every allocation
+	assert(this && stats);
+	size_t free_bytes = 0;
+	unsigned nb_free = 0;
+	for (unsigned c=0; c<ARENA_NB_CLASSES; c++) {
+		for (void *block = this->free_blocks[c]; block; block = *(void **)block) {
+			free_bytes += class_size(c);
+			nb_free ++;
+		}
+	}
+	size_t carved = this->nb_used_chunks ? (this->nb_used_chunks-1) * this->chunk_size + this->used : 0;
+	stats->nb_elmnts = this->nb_blocks;
+	stats->capacity = this->nb_blocks + nb_free;
+	stats->bytes = this->nb_chunks * this->chunk_size + this->large_bytes + this->max_chunks * sizeof(*this->chunks) + this->max_large * sizeof(*this->large);
+	stats->used = carved + this->large_bytes - free_bytes;
+}
+
+// vi:ts=3:sw=3
@@ -0,0 +1,54 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef ARENA_H_060315
+#define ARENA_H_060315
+
+/* Small blocks of memory owned by a grid, carved from big chunks.
+ * Freed blocks are kept by size class for reuse ; all the chunks are
+ * released at once by Arena_destruct, or kept for reuse by Arena_clear.
+ */
+
+#include <stddef.h>
+#include "libmicromodel/grid.h"
+
+#define ARENA_MIN_BLOCK 16
+#define ARENA_NB_CLASSES 28
+
+typedef struct Arena {
+	size_t chunk_size;
+	unsigned nb_chunks, max_chunks;
+	void **chunks;
+	unsigned nb_used_chunks;	// blocks are carved from the last used chunk
+	size_t used;	// in this chunk
+	unsigned nb_large, max_large;
+	void **large;	// blocks too big for a chunk
+	void *free_blocks[ARENA_NB_CLASSES];	// linked through themselves
+	unsigned nb_blocks;	// in use
+	size_t large_bytes;
+} Arena;
+
+void Arena_construct(Arena *this, size_t chunk_size);
+void Arena_destruct(Arena *this);
+void Arena_clear(Arena *this);
+void *Arena_alloc(Arena *this, size_t size);
+void *Arena_realloc(Arena *this, void *ptr, size_t old_size, size_t new_size);
+void Arena_free(Arena *this, void *ptr, size_t size);
+void Arena_stats(const Arena *this, GridMemStats *stats);
+
+#endif
+// vi:ts=3:sw=3
@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <libcnt/vec.h>
+#include <libcnt/hash.h>
 #include <libcnt/log.h>
 #include "libmicromodel/grid.h"
 #include "libmicromodel/facet.h"
@@ -165,9 +166,10 @@ GridSel GridSel_bevel(GridSel *beveled_edges, GridSel *additionnal_vertices, dou
 			} else if (GridSel_selected(beveled_edges, next_e=Vertex_get_edge(v, (i+1)%(int)v_size))) {
 				Vertex *next_v_l = Edge_get_vertex(next_e, SOUTH);
 				if (next_v_l == v) next_v_l = Edge_get_vertex(next_e, NORTH);
-				Vertex temp;
-				Vertex_construct_average(&temp, 0, v_l, next_v_l, 0.5);	// FIXME: si v_l, v et next_v_l sont aligns, c'est pas gnial (meme si topologiquement c'est OK).
-				cov->covertices[i] = Grid_vertex_average_new(v, &temp, 2.*ratio);
+				Vertex *temp = Grid_vertex_average_new(v_l, next_v_l, 0.5);	// FIXME: si v_l, v et next_v_l sont aligns, c'est pas gnial (meme si topologiquement c'est OK).
+				// then averaged with v in place, not to take one more name
+				if (temp) Vertex_construct_average(temp, Vertex_name(temp), v, temp, 2.*ratio);
+				cov->covertices[i] = temp;
 			} else {
 				cov->covertices[i] = NULL;
 				continue;
@@ -249,7 +251,6 @@ GridSel GridSel_bevel(GridSel *beveled_edges, GridSel *additionnal_vertices, dou
 			Grid_replace_vertex(covNW, NULL);
 		}
 	}
-	GridSel_destruct(&beveled_vertices);
 	//
 	// Build Cofacets
 	//
@@ -295,16 +296,15 @@ GridSel GridSel_bevel(GridSel *beveled_edges, GridSel *additionnal_vertices, dou
 		}
 	}
 	//
-	// Remove pending vertices
+	// Remove pending vertices, by name so that the freed slots are reused in the same order on every run
 	//
-	cntHash_reset(covertices);
-	cntHashkey key;
-	while (cntHash_each(covertices, &key, NULL)) {
-		Grid_replace_vertex(key.ptr, NULL);
+	GridSel_reset(&beveled_vertices);
+	while ( (v=GridSel_each(&beveled_vertices)) ) {
+		if (cntHash_get(covertices, (cntHashkey){ .ptr = v })) Grid_replace_vertex(v, NULL);
 	}
-	cntHash_reset(coedges);
-	while (cntHash_each(coedges, &key, NULL)) {
-		Grid_replace_edge(key.ptr, NULL);
+	GridSel_reset(beveled_edges);
+	while ( (e=GridSel_each(beveled_edges)) ) {
+		if (cntHash_get(coedges, (cntHashkey){ .ptr = e })) Grid_replace_edge(e, NULL);
 	}
 free_n_quit:
 	if (covertices) {
@@ -313,6 +313,7 @@ free_n_quit:
 	if (coedges) {
 		cntHash_del(coedges);
 	}
+	GridSel_destruct(&beveled_vertices);
 	GridSel_destruct(&beveled_facets);
 	return my_result;
 }
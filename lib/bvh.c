@@ -0,0 +1,581 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "../config.h"
+#include <assert.h>
+#include <math.h>
+#include <limits.h>
+#include <libcnt/mem.h>
+#include "libmicromodel/vertex.h"
+#include "bvh.h"
+
+#define BVH_LEAF_SIZE 4	// no need to split below
+#define BVH_MAX_LEAF 16	// must split above
+#define BVH_NB_BINS 12
+#define BVH_MAX_DEPTH 96
+#define BVH_MEDIAN_DEPTH 48	// below, split in halves so that the depth stays bounded
+
+/* Private Functions */
+
+static void *grow(void *ptr, size_t size) {
+	void *tmp = ptr ? mem_realloc(ptr, size) : mem_alloc(size);
+	if (!tmp && ptr) mem_unregister(ptr);
+	return tmp;
+}
+
+static void box_empty(double min[3], double max[3]) {
+	for (unsigned a=0; a<3; a++) {
+		min[a] = HUGE_VAL;
+		max[a] = -HUGE_VAL;
+	}
+}
+
+static void box_grow(double min[3], double max[3], const double pmin[3], const double pmax[3]) {
+	for (unsigned a=0; a<3; a++) {
+		if (pmin[a] < min[a]) min[a] = pmin[a];
+		if (pmax[a] > max[a]) max[a] = pmax[a];
+	}
+}
+
+static double box_area(const double min[3], const double max[3]) {
+	double d[3] = { max[0]-min[0], max[1]-min[1], max[2]-min[2] };
+	if (d[0] < 0.) return 0.;
+	return 2.*(d[0]*d[1] + d[1]*d[2] + d[2]*d[0]);
+}
+
+static double box_dist2(const double min[3], const double max[3], const Vec *p) {
+	double d2 = 0.;
+	for (unsigned a=0; a<3; a++) {
+		double d = Vec_coord(p, a) < min[a] ? min[a]-Vec_coord(p, a) : Vec_coord(p, a) > max[a] ? Vec_coord(p, a)-max[a] : 0.;
+		d2 += d*d;
+	}
+	return d2;
+}
+
+static bool box_overlap(const double min[3], const double max[3], const Vec *bmin, const Vec *bmax) {
+	for (unsigned a=0; a<3; a++) {
+		if (max[a] < Vec_coord(bmin, a) || min[a] > Vec_coord(bmax, a)) return false;
+	}
+	return true;
+}
+
+static bool box_ray(const double min[3], const double max[3], const Vec *origin, const double inv[3], double t_max) {
+	// slabs
+	double t0 = 0., t1 = t_max;
+	for (unsigned a=0; a<3; a++) {
+		double ta = (min[a] - Vec_coord(origin, a)) * inv[a];
+		double tb = (max[a] - Vec_coord(origin, a)) * inv[a];
+		if (ta > tb) { double t = ta; ta = tb; tb = t; }
+		if (ta > t0) t0 = ta;
+		if (tb < t1) t1 = tb;
+		if (t0 > t1) return false;
+	}
+	return true;
+}
+
+static void facet_box(Facet *facet, double min[3], double max[3]) {
+	box_empty(min, max);
+	for (unsigned i=0; i<Facet_size(facet); i++) {
+		Vec p;
+		Vertex_get_position(Facet_get_vertex(facet, i), &p);
+		box_grow(min, max, p.c, p.c);
+	}
+}
+
+static bool region_overlap(const BVHRegion *region, const double min[3], const double max[3]) {
+	// false only if no point of the box is in the region
+	Vec corner, axis, d;
+	double len2, t, half2;
+	switch (region->type) {
+		case BVHRegion_BOX:
+			return box_overlap(min, max, &region->a, &region->b);
+		case BVHRegion_SPHERE:
+			return box_dist2(min, max, &region->a) <= region->radius*region->radius;
+		case BVHRegion_HALFSPACE:
+			// the corner furthest along the normal
+			for (unsigned a=0; a<3; a++) Vec_coord_set(&corner, a, Vec_coord(&region->b, a) >= 0. ? max[a] : min[a]);
+			Vec_sub(&corner, &region->a);
+			return Vec_scalar(&corner, &region->b) >= 0.;
+		case BVHRegion_CYLINDER:
+			break;
+	}
+	// the bounding box of the cylinder, then the distance from the center of the box to the axis
+	Vec_sub3(&axis, &region->b, &region->a);
+	len2 = Vec_norm2(&axis);
+	for (unsigned a=0; a<3; a++) {
+		double ext = len2 > 0. ? region->radius * sqrt(fmax(0., 1. - Vec_coord(&axis, a)*Vec_coord(&axis, a)/len2)) : region->radius;
+		double lo = fmin(Vec_coord(&region->a, a), Vec_coord(&region->b, a)) - ext;
+		double hi = fmax(Vec_coord(&region->a, a), Vec_coord(&region->b, a)) + ext;
+		if (max[a] < lo || min[a] > hi) return false;
+	}
+	half2 = 0.;
+	for (unsigned a=0; a<3; a++) {
+		Vec_coord_set(&d, a, .5*(min[a]+max[a]) - Vec_coord(&region->a, a));
+		half2 += .25*(max[a]-min[a])*(max[a]-min[a]);
+	}
+	t = len2 > 0. ? fmin(1., fmax(0., Vec_scalar(&d, &axis) / len2)) : 0.;
+	Vec_add_scale(&d, -t, &axis);
+	return Vec_norm(&d) <= region->radius + sqrt(half2);
+}
+
+static bool triangle_ray(const Vec *p0, const Vec *p1, const Vec *p2, const Vec *origin, const Vec *dir, double *t) {
+	// Moller-Trumbore, both sides
+	Vec e1, e2, h, s, q;
+	Vec_sub3(&e1, p1, p0);
+	Vec_sub3(&e2, p2, p0);
+	Vec_product(&h, dir, &e2);
+	double det = Vec_scalar(&e1, &h);
+	if (fabs(det) < 1e-12) return false;
+	double inv = 1./det;
+	Vec_sub3(&s, origin, p0);
+	double u = inv * Vec_scalar(&s, &h);
+	if (u < 0. || u > 1.) return false;
+	Vec_product(&q, &s, &e1);
+	double v = inv * Vec_scalar(dir, &q);
+	if (v < 0. || u+v > 1.) return false;
+	*t = inv * Vec_scalar(&e2, &q);
+	return *t >= 0.;
+}
+
+static void triangle_nearest(const Vec *a, const Vec *b, const Vec *c, const Vec *p, Vec *res) {
+	// closest point of the triangle, by Voronoi regions
+	Vec ab, ac, ap, bp, cp;
+	Vec_sub3(&ab, b, a);
+	Vec_sub3(&ac, c, a);
+	Vec_sub3(&ap, p, a);
+	double d1 = Vec_scalar(&ab, &ap), d2 = Vec_scalar(&ac, &ap);
+	if (d1 <= 0. && d2 <= 0.) { *res = *a; return; }
+	Vec_sub3(&bp, p, b);
+	double d3 = Vec_scalar(&ab, &bp), d4 = Vec_scalar(&ac, &bp);
+	if (d3 >= 0. && d4 <= d3) { *res = *b; return; }
+	double vc = d1*d4 - d3*d2;
+	if (vc <= 0. && d1 >= 0. && d3 <= 0.) {
+		*res = *a;
+		Vec_add_scale(res, d1/(d1-d3), &ab);
+		return;
+	}
+	Vec_sub3(&cp, p, c);
+	double d5 = Vec_scalar(&ab, &cp), d6 = Vec_scalar(&ac, &cp);
+	if (d6 >= 0. && d5 <= d6) { *res = *c; return; }
+	double vb = d5*d2 - d1*d6;
+	if (vb <= 0. && d2 >= 0. && d6 <= 0.) {
+		*res = *a;
+		Vec_add_scale(res, d2/(d2-d6), &ac);
+		return;
+	}
+	double va = d3*d6 - d5*d4;
+	if (va <= 0. && d4-d3 >= 0. && d5-d6 >= 0.) {
+		Vec bc;
+		Vec_sub3(&bc, c, b);
+		*res = *b;
+		Vec_add_scale(res, (d4-d3)/((d4-d3)+(d5-d6)), &bc);
+		return;
+	}
+	double denom = 1./(va+vb+vc);
+	*res = *a;
+	Vec_add_scale(res, vb*denom, &ab);
+	Vec_add_scale(res, vc*denom, &ac);
+}
+
+// Facets are cut in a fan of triangles around their first vertex
+
+static bool facet_ray(Facet *facet, const Vec *origin, const Vec *dir, double *t) {
+	bool hit = false;
+	Vec p0, p1, p2;
+	Vertex_get_position(Facet_get_vertex(facet, 0), &p0);
+	for (unsigned i=1; i+1<Facet_size(facet); i++) {
+		double ti;
+		Vertex_get_position(Facet_get_vertex(facet, i), &p1);
+		Vertex_get_position(Facet_get_vertex(facet, i+1), &p2);
+		if (triangle_ray(&p0, &p1, &p2, origin, dir, &ti) && ti < *t) {
+			*t = ti;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+static bool facet_nearest(Facet *facet, const Vec *p, Vec *nearest, double *d2) {
+	bool closer = false;
+	unsigned size = Facet_size(facet);
+	Vec p0, p1, p2;
+	Vertex_get_position(Facet_get_vertex(facet, 0), &p0);
+	for (unsigned i=1; i+1<size || (size<3 && i==1); i++) {
+		Vec res;
+		Vertex_get_position(Facet_get_vertex(facet, i<size ? i:0), &p1);
+		Vertex_get_position(Facet_get_vertex(facet, i+1<size ? i+1:0), &p2);
+		triangle_nearest(&p0, &p1, &p2, p, &res);
+		double d = Vec_dist(&res, p);
+		if (d*d < *d2) {
+			*d2 = d*d;
+			*nearest = res;
+			closer = true;
+		}
+	}
+	return closer;
+}
+
+struct prim {
+	unsigned name;
+	double min[3], max[3], c[3];
+};
+
+struct range {	// of prims still to split
+	unsigned node, begin, end, depth;
+};
+
+static unsigned bin_of(const struct prim *prim, unsigned axis, double cmin, double scale) {
+	unsigned b = (unsigned)((prim->c[axis] - cmin) * scale);
+	return b < BVH_NB_BINS ? b : BVH_NB_BINS-1;
+}
+
+static unsigned split(struct prim *prims, unsigned begin, unsigned end, const double node_min[3], const double node_max[3], unsigned depth) {
+	// Where to split prims[begin..end[, after reordering them ; end if it's better not to split
+	unsigned count = end - begin;
+	if (count <= BVH_LEAF_SIZE) return end;
+	double cmin[3], cmax[3];
+	box_empty(cmin, cmax);
+	for (unsigned i=begin; i<end; i++) box_grow(cmin, cmax, prims[i].c, prims[i].c);
+	unsigned best_axis = 3, best_bin = 0;
+	double best_cost = HUGE_VAL;
+	for (unsigned a=0; depth < BVH_MEDIAN_DEPTH && a<3; a++) {
+		double extent = cmax[a] - cmin[a];
+		if (extent <= 0.) continue;
+		double scale = BVH_NB_BINS / extent;
+		unsigned counts[BVH_NB_BINS] = { 0 };
+		double bmin[BVH_NB_BINS][3], bmax[BVH_NB_BINS][3];
+		for (unsigned b=0; b<BVH_NB_BINS; b++) box_empty(bmin[b], bmax[b]);
+		for (unsigned i=begin; i<end; i++) {
+			unsigned b = bin_of(prims+i, a, cmin[a], scale);
+			counts[b] ++;
+			box_grow(bmin[b], bmax[b], prims[i].min, prims[i].max);
+		}
+		// areas of what's right of each split, then sweep from the left
+		double right_area[BVH_NB_BINS];
+		unsigned right_count[BVH_NB_BINS];
+		double min[3], max[3];
+		box_empty(min, max);
+		unsigned n = 0;
+		for (unsigned b=BVH_NB_BINS-1; b>0; b--) {
+			box_grow(min, max, bmin[b], bmax[b]);
+			n += counts[b];
+			right_area[b] = box_area(min, max);
+			right_count[b] = n;
+		}
+		box_empty(min, max);
+		n = 0;
+		for (unsigned b=1; b<BVH_NB_BINS; b++) {
+			box_grow(min, max, bmin[b-1], bmax[b-1]);
+			n += counts[b-1];
+			if (!n || !right_count[b]) continue;
+			double cost = n*box_area(min, max) + right_count[b]*right_area[b];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = a;
+				best_bin = b;
+			}
+		}
+	}
+	unsigned mid = begin + count/2;
+	if (best_axis < 3) {
+		if (best_cost >= count*box_area(node_min, node_max) && count <= BVH_MAX_LEAF) return end;
+		double scale = BVH_NB_BINS / (cmax[best_axis] - cmin[best_axis]);
+		unsigned i = begin, j = end;
+		while (i < j) {
+			if (bin_of(prims+i, best_axis, cmin[best_axis], scale) < best_bin) {
+				i ++;
+			} else {
+				struct prim tmp = prims[i];
+				prims[i] = prims[--j];
+				prims[j] = tmp;
+			}
+		}
+		if (i > begin && i < end) mid = i;
+	} else if (count <= BVH_MAX_LEAF) {	// all at the same place
+		return end;
+	}
+	return mid;
+}
+
+static int BVH_build(BVH *this) {
+	unsigned nb = ElmntTable_size(this->facets);
+	struct prim *prims = mem_alloc((nb+1) * sizeof(*prims));
+	if (! prims) return 0;
+	unsigned n = 0, i = 0;
+	Facet *f;
+	while ( (f = ElmntTable_next(this->facets, &n, UINT_MAX)) ) {
+		struct prim *prim = prims + i++;
+		prim->name = Facet_name(f);
+		facet_box(f, prim->min, prim->max);
+		for (unsigned a=0; a<3; a++) prim->c[a] = .5*(prim->min[a] + prim->max[a]);
+	}
+	assert(i == nb);
+	if (2*nb+1 > this->max_nodes) {
+		this->nodes = grow(this->nodes, (2*nb+1) * sizeof(*this->nodes));
+		this->max_nodes = this->nodes ? 2*nb+1 : 0;
+	}
+	if (nb+1 > this->max_names) {
+		this->names = grow(this->names, (nb+1) * sizeof(*this->names));
+		this->max_names = this->names ? nb+1 : 0;
+	}
+	if (! this->nodes || ! this->names) {
+		mem_unregister(prims);
+		return 0;
+	}
+	// depth first
+	struct range stack[2*BVH_MAX_DEPTH];
+	unsigned top = 0;
+	this->nb_nodes = 1;
+	stack[top++] = (struct range){ 0, 0, nb, 0 };
+	while (top > 0) {
+		struct range s = stack[--top];
+		BVHNode *node = this->nodes + s.node;
+		box_empty(node->min, node->max);
+		for (i=s.begin; i<s.end; i++) box_grow(node->min, node->max, prims[i].min, prims[i].max);
+		unsigned mid = split(prims, s.begin, s.end, node->min, node->max, s.depth);
+		if (mid == s.end) {
+			node->first = s.begin;
+			node->count = s.end - s.begin;
+			continue;
+		}
+		assert(s.depth < BVH_MAX_DEPTH && top+2 <= 2*BVH_MAX_DEPTH);
+		node->first = this->nb_nodes;
+		node->count = 0;
+		this->nb_nodes += 2;
+		stack[top++] = (struct range){ node->first+1, mid, s.end, s.depth+1 };
+		stack[top++] = (struct range){ node->first, s.begin, mid, s.depth+1 };
+	}
+	for (i=0; i<nb; i++) this->names[i] = prims[i].name;
+	this->nb_names = nb;
+	this->built_names = ElmntTable_nb_names(this->facets);
+	mem_unregister(prims);
+	return 1;
+}
+
+static unsigned BVH_refit(BVH *this) {
+	// Children come after their parent, so a backward walk sees them first.
+	// Returns the number of facets removed since the build.
+	unsigned removed = 0;
+	for (unsigned n=this->nb_nodes; n-- > 0; ) {
+		BVHNode *node = this->nodes + n;
+		box_empty(node->min, node->max);
+		if (node->count) {
+			for (unsigned i=node->first; i<node->first+node->count; i++) {
+				Facet *f = ElmntTable_get(this->facets, this->names[i]);
+				if (! f) {
+					removed ++;
+					continue;
+				}
+				double min[3], max[3];
+				facet_box(f, min, max);
+				box_grow(node->min, node->max, min, max);
+			}
+		} else {
+			for (unsigned c=node->first; c<node->first+2; c++) {
+				box_grow(node->min, node->max, this->nodes[c].min, this->nodes[c].max);
+			}
+		}
+	}
+	return removed;
+}
+
+/* Public Functions */
+
+void BVH_construct(BVH *this, const ElmntTable *facets) {
+	assert(this && facets);
+	this->facets = facets;
+	this->version = 0;
+	this->nb_nodes = this->max_nodes = 0;
+	this->nodes = NULL;
+	this->nb_names = this->max_names = 0;
+	this->names = NULL;
+	this->built_names = 0;
+}
+
+void BVH_destruct(BVH *this) {
+	assert(this);
+	if (this->nodes) mem_unregister(this->nodes);
+	if (this->names) mem_unregister(this->names);
+	BVH_construct(this, this->facets);
+}
+
+void BVH_clear(BVH *this) {
+	// to be built again, in the same memory
+	assert(this);
+	this->version = 0;
+	this->nb_nodes = this->nb_names = this->built_names = 0;
+}
+
+int BVH_update(BVH *this, unsigned version) {
+	// fit the tree to the grid geometry of this version, building it again if too much changed
+	assert(this && version);
+	if (version == this->version) return 1;
+	unsigned nb_names = ElmntTable_nb_names(this->facets);
+	bool build = !this->version || nb_names < this->built_names || 4*(nb_names - this->built_names) > this->nb_names + 64;
+	if (! build) build = 2*BVH_refit(this) > this->nb_names;
+	if (build && ! BVH_build(this)) {
+		this->version = 0;
+		return 0;
+	}
+	this->version = version;
+	return 1;
+}
+
+void BVH_region(const BVH *this, const BVHRegion *region, BVH_visit visit, void *data) {
+	// visit the facets which bounding box may overlap region
+	assert(this && this->version && region && visit);
+	unsigned stack[2*BVH_MAX_DEPTH], top = 0;
+	if (this->nb_nodes) stack[top++] = 0;
+	while (top > 0) {
+		const BVHNode *node = this->nodes + stack[--top];
+		if (! region_overlap(region, node->min, node->max)) continue;
+		if (! node->count) {
+			stack[top++] = node->first+1;
+			stack[top++] = node->first;
+			continue;
+		}
+		for (unsigned i=node->first; i<node->first+node->count; i++) {
+			Facet *f = ElmntTable_get(this->facets, this->names[i]);
+			if (! f) continue;
+			double fmin[3], fmax[3];
+			facet_box(f, fmin, fmax);
+			if (region_overlap(region, fmin, fmax) && ! visit(f, data)) return;
+		}
+	}
+	unsigned n = this->built_names;
+	Facet *f;
+	while ( (f = ElmntTable_next(this->facets, &n, UINT_MAX)) ) {
+		double fmin[3], fmax[3];
+		facet_box(f, fmin, fmax);
+		if (region_overlap(region, fmin, fmax) && ! visit(f, data)) return;
+	}
+}
+
+void BVH_box(const BVH *this, const Vec *min, const Vec *max, BVH_visit visit, void *data) {
+	// visit the facets which bounding box overlaps [min, max]
+	assert(min && max);
+	BVHRegion region = { .type = BVHRegion_BOX, .a = *min, .b = *max };
+	BVH_region(this, &region, visit, data);
+}
+
+void BVH_sphere(const BVH *this, const Vec *center, double radius, BVH_visit visit, void *data) {
+	// visit the facets which bounding box is within radius of center
+	assert(center);
+	BVHRegion region = { .type = BVHRegion_SPHERE, .a = *center, .radius = radius };
+	BVH_region(this, &region, visit, data);
+}
+
+bool BVHRegion_contains(const BVHRegion *this, const Vec *point) {
+	assert(this && point);
+	Vec d, axis;
+	double t, len2;
+	switch (this->type) {
+		case BVHRegion_BOX:
+			for (unsigned a=0; a<3; a++) {
+				if (Vec_coord(point, a) < Vec_coord(&this->a, a) || Vec_coord(point, a) > Vec_coord(&this->b, a)) return false;
+			}
+			return true;
+		case BVHRegion_SPHERE:
+			Vec_sub3(&d, point, &this->a);
+			return Vec_norm2(&d) <= this->radius*this->radius;
+		case BVHRegion_HALFSPACE:
+			Vec_sub3(&d, point, &this->a);
+			return Vec_scalar(&d, &this->b) >= 0.;
+		case BVHRegion_CYLINDER:
+			break;
+	}
+	Vec_sub3(&axis, &this->b, &this->a);
+	Vec_sub3(&d, point, &this->a);
+	len2 = Vec_norm2(&axis);
+	t = len2 > 0. ? Vec_scalar(&d, &axis) / len2 : 0.;
+	if (t < 0. || t > 1.) return false;
+	Vec_add_scale(&d, -t, &axis);
+	return Vec_norm2(&d) <= this->radius*this->radius;
+}
+
+Facet *BVH_ray(const BVH *this, const Vec *origin, const Vec *dir, double *dist) {
+	// first facet hit by the half line, and at which multiple of dir
+	assert(this && this->version && origin && dir);
+	double inv[3];
+	for (unsigned a=0; a<3; a++) inv[a] = 1./Vec_coord(dir, a);	// infinite is fine
+	double best = HUGE_VAL;
+	Facet *hit = NULL;
+	unsigned stack[2*BVH_MAX_DEPTH], top = 0;
+	if (this->nb_nodes) stack[top++] = 0;
+	while (top > 0) {
+		const BVHNode *node = this->nodes + stack[--top];
+		if (! box_ray(node->min, node->max, origin, inv, best)) continue;
+		if (! node->count) {
+			stack[top++] = node->first+1;
+			stack[top++] = node->first;
+			continue;
+		}
+		for (unsigned i=node->first; i<node->first+node->count; i++) {
+			Facet *f = ElmntTable_get(this->facets, this->names[i]);
+			if (f && facet_ray(f, origin, dir, &best)) hit = f;
+		}
+	}
+	unsigned n = this->built_names;
+	Facet *f;
+	while ( (f = ElmntTable_next(this->facets, &n, UINT_MAX)) ) {
+		if (facet_ray(f, origin, dir, &best)) hit = f;
+	}
+	if (hit && dist) *dist = best;
+	return hit;
+}
+
+Facet *BVH_nearest(const BVH *this, const Vec *point, Vec *nearest) {
+	// facet closest to point, and its point closest to point
+	assert(this && this->version && point);
+	double best = HUGE_VAL;
+	Vec res;
+	Facet *found = NULL;
+	unsigned stack[2*BVH_MAX_DEPTH], top = 0;
+	if (this->nb_nodes) stack[top++] = 0;
+	while (top > 0) {
+		const BVHNode *node = this->nodes + stack[--top];
+		if (box_dist2(node->min, node->max, point) >= best) continue;
+		if (! node->count) {
+			// nearest child last, so that it's looked at first
+			const BVHNode *left = this->nodes + node->first;
+			bool left_first = box_dist2(left->min, left->max, point) <= box_dist2(left[1].min, left[1].max, point);
+			stack[top++] = node->first + left_first;
+			stack[top++] = node->first + !left_first;
+			continue;
+		}
+		for (unsigned i=node->first; i<node->first+node->count; i++) {
+			Facet *f = ElmntTable_get(this->facets, this->names[i]);
+			if (f && facet_nearest(f, point, &res, &best)) found = f;
+		}
+	}
+	unsigned n = this->built_names;
+	Facet *f;
+	while ( (f = ElmntTable_next(this->facets, &n, UINT_MAX)) ) {
+		if (facet_nearest(f, point, &res, &best)) found = f;
+	}
+	if (found && nearest) *nearest = res;
+	return found;
+}
+
+void BVH_stats(const BVH *this, GridMemStats *stats) {
+	assert(this && stats);
+	stats->nb_elmnts = this->nb_names;
+	stats->capacity = this->max_names;
+	stats->bytes = this->max_nodes * sizeof(*this->nodes) + this->max_names * sizeof(*this->names);
+	stats->used = this->nb_nodes * sizeof(*this->nodes) + this->nb_names * sizeof(*this->names);
+}
+// vi:ts=3:sw=3
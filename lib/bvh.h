@@ -0,0 +1,74 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef BVH_H_060418
+#define BVH_H_060418
+
+/* Bounding volume hierarchy over the facets of a grid, for spatial queries.
+ * Built with the surface area heuristic, then refitted when vertices move or
+ * facets change. Facets created since the build are kept aside and tested one
+ * by one, until there are enough of them to build the whole tree again.
+ */
+
+#include <stdbool.h>
+#include <libcnt/vec.h>
+#include "libmicromodel/facet.h"
+#include "table.h"
+#include "libmicromodel/grid.h"
+
+typedef struct BVHNode {
+	double min[3], max[3];
+	unsigned first;	// first facet of a leaf, or left child (right one follows)
+	unsigned count;	// number of facets of a leaf, 0 for inner nodes
+} BVHNode;
+
+typedef struct BVH {
+	const ElmntTable *facets;	// of the grid
+	unsigned version;	// of the grid geometry it fits, 0 if not built
+	unsigned nb_nodes, max_nodes;
+	BVHNode *nodes;	// root first, children after their parent
+	unsigned nb_names, max_names;
+	unsigned *names;	// of the facets, by leaf
+	unsigned built_names;	// facets named from there on are not in the tree
+} BVH;
+
+// return false to stop the traversal
+typedef bool (*BVH_visit)(Facet *facet, void *data);
+
+typedef enum { BVHRegion_BOX, BVHRegion_SPHERE, BVHRegion_HALFSPACE, BVHRegion_CYLINDER } BVHRegion_type;
+
+typedef struct BVHRegion {
+	BVHRegion_type type;
+	Vec a, b;	// min and max corners, center, a point of the plane and the normal, or both ends of the axis
+	double radius;	// of the sphere or the cylinder
+} BVHRegion;
+
+bool BVHRegion_contains(const BVHRegion *this, const Vec *point);
+
+void BVH_construct(BVH *this, const ElmntTable *facets);
+void BVH_destruct(BVH *this);
+void BVH_clear(BVH *this);
+int BVH_update(BVH *this, unsigned version);
+void BVH_box(const BVH *this, const Vec *min, const Vec *max, BVH_visit visit, void *data);
+void BVH_sphere(const BVH *this, const Vec *center, double radius, BVH_visit visit, void *data);
+void BVH_region(const BVH *this, const BVHRegion *region, BVH_visit visit, void *data);
+Facet *BVH_ray(const BVH *this, const Vec *origin, const Vec *dir, double *dist);
+Facet *BVH_nearest(const BVH *this, const Vec *point, Vec *nearest);
+void BVH_stats(const BVH *this, GridMemStats *stats);
+
+#endif
+// vi:ts=3:sw=3
@@ -106,15 +106,16 @@ static bool intersect(const Vec *a, const Vec *b, const Vec *c, const Vec *d) {
 static bool facet_intersect(const Facet *facet, Vertex *v1, Vertex *v2) {
 	assert(facet && v1 && v2 && v1 != v2);
 	Vertex *v_prev, *v_next;
-	const Vec *a = Vertex_position(v1);
-	const Vec *b = Vertex_position(v2);
+	Vec a, b, p, n;
+	Vertex_get_position(v1, &a);
+	Vertex_get_position(v2, &b);
 	unsigned fsize = Facet_size(facet);
 	for (unsigned i=0; i<fsize; i++) {
 		if (i) v_prev = v_next;
 		else v_prev = Facet_get_vertex(facet, i);
 		v_next = Facet_get_vertex(facet, i==fsize-1 ? 0:i+1);
 		if (v_prev==v1 || v_next==v1 || v_prev==v2 || v_next==v2) continue;
-		if (intersect(a, b, Vertex_position(v_prev), Vertex_position(v_next))) {
+		if (intersect(&a, &b, Vertex_get_position(v_prev, &p), Vertex_get_position(v_next, &n))) {
 			return true;
 		}
 	}
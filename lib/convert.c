@@ -16,148 +16,321 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 #include <assert.h>
-#include <libcnt/hash.h>
+#include <limits.h>
+#include <libcnt/mem.h>
 #include <libcnt/log.h>
 #include "libmicromodel/grid.h"
 #include "gridsel.h"
+#include "grid.h"
+#include "table.h"
+#include "incidence.h"
 
 /* Private Functions */
 
-/* Public Functions */
+// Small selections follow the elements rather than having the incidence tables built
+#define INCIDENCE_MIN_SHARE 8
 
-void GridSel_convert(GridSel *restrict this, GridSel *restrict my_result, GridSel_type type, GridSel_convert_type convert_type) {
-	assert(this && my_result && this!=my_result);
-	cntHashkey key;
-	if (
-			(type == GridSel_VERTEX && this->type == GridSel_FACET) ||
-			(type == GridSel_FACET && this->type == GridSel_VERTEX)
-		) {
-		GridSel tmp;
-		GridSel_convert(this, &tmp, GridSel_EDGE, convert_type);
-		GridSel_convert(&tmp, my_result, type, convert_type);
-		GridSel_destruct(&tmp);
-		return;
-	} else {
-		GridSel_construct(my_result, type);
-		if (type == this->type) {	// simple copy
-			GridSel_reset(this);
-			while ( (key.ptr=GridSel_each(this)) ) {
-				cntHash_put(my_result->elmnts, key, NULL);
+static const Incidence *incidence_for(const GridSel *this) {
+	return Grid_incidence(INCIDENCE_MIN_SHARE * this->size >= ElmntTable_nb_names(this->table));
+}
+
+static void vertices_to_edges(const GridSel *this, GridSel *my_result, bool min) {
+	// with min, only the edges which both vertices are selected
+	const Incidence *inc = incidence_for(this);
+	for (unsigned n = GridSel_next_name(this, 0); n != UINT_MAX; n = GridSel_next_name(this, n+1)) {
+		if (inc) {
+			if (n >= inc->nb_vertices) break;
+			for (unsigned i=inc->vertex_start[n]; i<inc->vertex_start[n+1]; i++) {
+				unsigned e = inc->vertex_edges[i];
+				const unsigned *poles = inc->edge_vertices + 2*e;
+				if (min && ! GridSel_selected_name(this, poles[poles[SOUTH]==n ? NORTH:SOUTH])) continue;
+				GridSel_add_name(my_result, e);
 			}
 		} else {
-			cntHash *h = cntHash_new(sizeof(int), 1+GridSel_size(this), 4, cntHash_PTRKEYS, 0);
-			assert(h);
-			static const int count_init = 1;
-			switch (this->type) {
-				case GridSel_VERTEX:
-					{
-						assert(type == GridSel_EDGE);
-						GridSel_reset(this);
-						Vertex *v;
-						int *count_ptr;
-						while ( (v=GridSel_each(this)) ) {
-							for (unsigned i=0; i<Vertex_size(v); i++) {
-								Edge *e = Vertex_get_edge(v, i);
-								key.ptr=e;
-								count_ptr = cntHash_get(h, key);
-								if (!count_ptr) {
-									cntHash_put(h, key, &count_init);
-								} else {
-									++*count_ptr;
-								}
-							}
-						}
-						cntHash_reset(h);
-						void *ptr;
-						while (cntHash_each(h, &key, &ptr)) {
-							count_ptr = ptr;
-							if (convert_type==GridSel_MIN && *count_ptr<2) continue;
-							cntHash_put(my_result->elmnts, key, NULL);
+			Vertex *v = ElmntTable_get(this->table, n);
+			if (! v) continue;
+			for (unsigned i=0; i<Vertex_size(v); i++) {
+				Edge *e = Vertex_get_edge(v, i);
+				if (min && ! GridSel_selected(this, Edge_get_vertex(e, Edge_get_vertex(e, SOUTH)==v ? NORTH:SOUTH))) continue;
+				GridSel_add(my_result, e);
+			}
+		}
+	}
+}
+
+static void edges_to_vertices(const GridSel *this, GridSel *my_result) {
+	const Incidence *inc = incidence_for(this);
+	for (unsigned n = GridSel_next_name(this, 0); n != UINT_MAX; n = GridSel_next_name(this, n+1)) {
+		if (inc) {
+			if (n >= inc->nb_edges) break;
+			for (unsigned i=SOUTH; i<=NORTH; i++) {
+				if (inc->edge_vertices[2*n+i] != INCIDENCE_NONE) GridSel_add_name(my_result, inc->edge_vertices[2*n+i]);
+			}
+		} else {
+			Edge *e = ElmntTable_get(this->table, n);
+			if (! e) continue;
+			for (unsigned i=SOUTH; i<=NORTH; i++) GridSel_add(my_result, Edge_get_vertex(e, i));
+		}
+	}
+}
+
+static void edges_to_facets(const GridSel *this, GridSel *my_result, bool min) {
+	// with min, only the facets which edges are all selected
+	const Incidence *inc = incidence_for(this);
+	for (unsigned n = GridSel_next_name(this, 0); n != UINT_MAX; n = GridSel_next_name(this, n+1)) {
+		if (inc) {
+			if (n >= inc->nb_edges) break;
+			for (unsigned s=WEST; s<=EAST; s++) {
+				unsigned f = inc->edge_facets[2*n+s];
+				if (f == INCIDENCE_NONE || GridSel_selected_name(my_result, f)) continue;
+				unsigned i = inc->facet_start[f];
+				if (min) while (i < inc->facet_start[f+1] && GridSel_selected_name(this, inc->facet_edges[i])) i++;
+				if (! min || i == inc->facet_start[f+1]) GridSel_add_name(my_result, f);
+			}
+		} else {
+			Edge *e = ElmntTable_get(this->table, n);
+			if (! e) continue;
+			for (unsigned s=WEST; s<=EAST; s++) {
+				Facet *f = Edge_get_facet(e, s);
+				if (! f || GridSel_selected(my_result, f)) continue;
+				unsigned i = 0;
+				if (min) while (i < Facet_size(f) && GridSel_selected(this, Facet_get_edge(f, i))) i++;
+				if (! min || i == Facet_size(f)) GridSel_add(my_result, f);
+			}
+		}
+	}
+}
+
+static void facets_to_edges(const GridSel *this, GridSel *my_result, bool vertices) {
+	// the edges of the facets, or their vertices
+	const Incidence *inc = incidence_for(this);
+	for (unsigned n = GridSel_next_name(this, 0); n != UINT_MAX; n = GridSel_next_name(this, n+1)) {
+		if (inc) {
+			if (n >= inc->nb_facets) break;
+			const unsigned *names = vertices ? inc->facet_vertices : inc->facet_edges;
+			for (unsigned i=inc->facet_start[n]; i<inc->facet_start[n+1]; i++) GridSel_add_name(my_result, names[i]);
+		} else {
+			Facet *f = ElmntTable_get(this->table, n);
+			if (! f) continue;
+			for (unsigned i=0; i<Facet_size(f); i++) {
+				if (vertices) {
+					GridSel_add(my_result, Facet_get_vertex(f, i));
+				} else {
+					GridSel_add(my_result, Facet_get_edge(f, i));
+				}
+			}
+		}
+	}
+}
+
+struct rings {	// breadth first walk over the facets around a frontier of vertices
+	GridSel *this;
+	bool grow;
+	GridSel region;	// facets reached, for selections of vertices or edges
+	GridSel visited;	// vertices queued
+	Vertex **queue;	// the frontier of each ring after the previous one
+	unsigned nb_queued, max_queued;
+	unsigned *rings;	// by name, may be NULL
+	unsigned nb_names;
+};
+
+static void *grow(void *ptr, size_t size) {
+	void *tmp = ptr ? mem_realloc(ptr, size) : mem_alloc(size);
+	if (!tmp && ptr) mem_unregister(ptr);
+	return tmp;
+}
+
+static bool queue_vertex(struct rings *r, Vertex *v) {
+	if (GridSel_selected(&r->visited, v)) return true;
+	if (! GridSel_add(&r->visited, v)) return false;
+	if (r->nb_queued == r->max_queued) {
+		r->max_queued = 2*r->max_queued + 64;
+		r->queue = grow(r->queue, r->max_queued * sizeof(*r->queue));
+		if (! r->queue) return false;
+	}
+	r->queue[r->nb_queued++] = v;
+	return true;
+}
+
+static bool reached(const struct rings *r, Facet *f) {
+	// on the starting side already
+	if (r->this->type == GridSel_FACET) return GridSel_selected(r->this, f) == r->grow;
+	return GridSel_selected(&r->region, f);
+}
+
+static void cross(struct rings *r, void *elmnt, unsigned ring) {
+	// bring an element of the selection type to the starting side
+	if (GridSel_selected(r->this, elmnt) == r->grow) return;
+	if (r->grow) {
+		GridSel_add(r->this, elmnt);
+	} else {
+		GridSel_remove(r->this, elmnt);
+	}
+	unsigned name = GridSel_name(r->this, elmnt);
+	if (name < r->nb_names) r->rings[name] = ring;
+}
+
+static bool reach(struct rings *r, Facet *f, unsigned ring) {
+	// f and its elements come to the starting side, its vertices make the next frontier
+	switch (r->this->type) {
+		case GridSel_FACET:
+			cross(r, f, ring);
+			break;
+		case GridSel_VERTEX:
+			if (! GridSel_add(&r->region, f)) return false;
+			for (unsigned i=0; i<Facet_size(f); i++) cross(r, Facet_get_vertex(f, i), ring);
+			break;
+		case GridSel_EDGE:
+			if (! GridSel_add(&r->region, f)) return false;
+			for (unsigned i=0; i<Facet_size(f); i++) cross(r, Facet_get_edge(f, i), ring);
+			break;
+	}
+	for (unsigned i=0; i<Facet_size(f); i++) {
+		if (! queue_vertex(r, Facet_get_vertex(f, i))) return false;
+	}
+	return true;
+}
+
+static bool has_unselected_edge(const GridSel *this, Vertex *v) {
+	for (unsigned i=0; i<Vertex_size(v); i++) {
+		if (! GridSel_selected(this, Vertex_get_edge(v, i))) return true;
+	}
+	return false;
+}
+
+static bool seed(struct rings *r) {
+	// first frontier : the vertices of the starting side next to the other one
+	GridSel *this = r->this;
+	for (unsigned n = GridSel_next_name(this, 0); n != UINT_MAX; n = GridSel_next_name(this, n+1)) {
+		void *elmnt = ElmntTable_get(this->table, n);
+		if (! elmnt) continue;
+		switch (this->type) {
+			case GridSel_FACET:
+				// vertices between selected and unselected facets, whatever the side
+				for (unsigned i=0; i<Facet_size(elmnt); i++) {
+					Vertex *v = Facet_get_vertex(elmnt, i);
+					for (unsigned j=0; j<Vertex_size(v); j++) {
+						Facet *f = Vertex_get_facet(v, j);
+						if (f && ! GridSel_selected(this, f)) {
+							if (! queue_vertex(r, v)) return false;
+							break;
 						}
 					}
+				}
+				break;
+			case GridSel_VERTEX:
+				if (r->grow) {
+					if (! queue_vertex(r, elmnt)) return false;
 					break;
-				case GridSel_EDGE:
-					switch (type) {
-						case GridSel_VERTEX:
-							{
-								GridSel_reset(this);
-								Edge *e;
-								while ( (e=GridSel_each(this)) ) {
-									for (unsigned i=SOUTH; i<=NORTH; i++) {
-										Vertex *v = Edge_get_vertex(e, i);
-										key.ptr=v;
-										cntHash_put(my_result->elmnts, key, NULL);
-									}
-								}
-							}
-							break;
-						case GridSel_FACET:
-							{
-								GridSel_reset(this);
-								Edge *e;
-								int *count_ptr;
-								while ( (e=GridSel_each(this)) ) {
-									for (unsigned i=WEST; i<=EAST; i++) {
-										Facet *f = Edge_get_facet(e, i);
-										key.ptr=f;
-										count_ptr = cntHash_get(h, key);
-										if (!count_ptr) {
-											cntHash_put(h, key, &count_init);
-										} else {
-											++*count_ptr;
-										}
-									}
-								}
-								cntHash_reset(h);
-								void *ptr;
-								while (cntHash_each(h, &key, &ptr)) {
-									count_ptr = ptr;
-									if (convert_type==GridSel_MIN && *count_ptr<(signed)Facet_size(key.ptr)) continue;
-									cntHash_put(my_result->elmnts, key, NULL);
-								}
-							}
-							break;
-						default:
-							assert(0);
+				}
+				// unselected vertices sharing a facet with this one
+				for (unsigned j=0; j<Vertex_size(elmnt); j++) {
+					Facet *f = Vertex_get_facet(elmnt, j);
+					if (! f) continue;
+					for (unsigned i=0; i<Facet_size(f); i++) {
+						Vertex *v = Facet_get_vertex(f, i);
+						if (! GridSel_selected(this, v) && ! queue_vertex(r, v)) return false;
 					}
+				}
+				break;
+			case GridSel_EDGE:
+				if (r->grow) {
+					if (! queue_vertex(r, Edge_get_vertex(elmnt, SOUTH)) || ! queue_vertex(r, Edge_get_vertex(elmnt, NORTH))) return false;
 					break;
-				case GridSel_FACET:
-					{
-						assert(type == GridSel_EDGE);
-						GridSel_reset(this);
-						Facet *f;
-						while ( (f=GridSel_each(this)) ) {
-							for (unsigned i=0; i<Facet_size(f); i++) {
-								Edge *e = Facet_get_edge(f, i);
-								key.ptr=e;
-								cntHash_put(my_result->elmnts, key, NULL);
-							}
-						}
+				}
+				// vertices of unselected edges, sharing a facet with this one
+				for (unsigned s=WEST; s<=EAST; s++) {
+					Facet *f = Edge_get_facet(elmnt, s);
+					if (! f) continue;
+					for (unsigned i=0; i<Facet_size(f); i++) {
+						Vertex *v = Facet_get_vertex(f, i);
+						if (has_unselected_edge(this, v) && ! queue_vertex(r, v)) return false;
 					}
-					break;
-				default:
-					assert(0);
-			}
-			cntHash_del(h);
+				}
+				break;
 		}
 	}
+	return true;
+}
+
+/* Public Functions */
+
+void GridSel_convert(GridSel *restrict this, GridSel *restrict my_result, GridSel_type type, GridSel_convert_type convert_type) {
+	assert(this && my_result && this!=my_result);
+	if (type == GridSel_FACET && this->type == GridSel_VERTEX) {
+		GridSel tmp;
+		GridSel_convert(this, &tmp, GridSel_EDGE, convert_type);
+		GridSel_convert(&tmp, my_result, type, convert_type);
+		GridSel_destruct(&tmp);
+		return;
+	}
+	GridSel_construct(my_result, type);
+	if (type == this->type) {	// simple copy
+		GridSel_add_or_sub(my_result, this, true);
+		return;
+	}
+	// so that adding names cannot fail
+	if (! GridSel_reserve(my_result, ElmntTable_nb_names(my_result->table))) {
+		log_warning(LOG_IMPORTANT, "Cannot convert a selection of %u elements", GridSel_size(this));
+		return;
+	}
+	bool min = convert_type == GridSel_MIN;
+	switch (this->type) {
+		case GridSel_VERTEX:
+			assert(type == GridSel_EDGE);
+			vertices_to_edges(this, my_result, min);
+			break;
+		case GridSel_EDGE:
+			if (type == GridSel_VERTEX) {
+				edges_to_vertices(this, my_result);
+			} else {
+				edges_to_facets(this, my_result, min);
+			}
+			break;
+		case GridSel_FACET:
+			// all the edges of a facet are selected, so all its vertices too
+			facets_to_edges(this, my_result, type == GridSel_VERTEX);
+			break;
+	}
 }
 
 void GridSel_propagate(GridSel *this, unsigned level) {
 	assert(this);
 	log_warning(LOG_DEBUG, "propagate this = %p", this);
-	GridSel_type initial_type = this->type;
-	GridSel tmp_result;
-	while (level--) {
-		GridSel_convert(this, &tmp_result, GridSel_VERTEX, GridSel_MAX /* unused */);
-		GridSel_destruct(this);
-		GridSel_convert(&tmp_result, this, GridSel_FACET, GridSel_MAX);
-		GridSel_destruct(&tmp_result);
+	GridSel_rings(this, level, true, NULL, 0);
+}
+
+void GridSel_shrink(GridSel *this, unsigned level) {
+	assert(this);
+	GridSel_rings(this, level, false, NULL, 0);
+}
+
+int GridSel_rings(GridSel *this, unsigned level, bool grow, unsigned *rings, unsigned nb_names) {
+	// Each ring brings the facets around the frontier vertices (and their elements) to the
+	// starting side : the selection if it grows, the rest of the grid if it shrinks.
+	assert(this && (rings || !nb_names));
+	struct rings r = { .this = this, .grow = grow, .rings = rings, .nb_names = nb_names };
+	for (unsigned n=0; n<nb_names; n++) {
+		rings[n] = GridSel_selected_name(this, n) == grow && ElmntTable_get(this->table, n) ? 0 : UINT_MAX;
 	}
-	if (this->type != initial_type) {
-		GridSel_convert(this, &tmp_result, initial_type, GridSel_MIN);
-		GridSel_destruct(this);
-		*this = tmp_result;
+	GridSel_construct(&r.region, GridSel_FACET);
+	GridSel_construct(&r.visited, GridSel_VERTEX);
+	bool ok = seed(&r);
+	unsigned start = 0;
+	for (unsigned ring=1; ok && ring<=level && start<r.nb_queued; ring++) {
+		unsigned end = r.nb_queued;
+		for (unsigned q=start; ok && q<end; q++) {
+			Vertex *v = r.queue[q];
+			for (unsigned i=0; ok && i<Vertex_size(v); i++) {
+				Facet *f = Vertex_get_facet(v, i);
+				if (f && ! reached(&r, f)) ok = reach(&r, f, ring);
+			}
+		}
+		start = end;
 	}
+	if (! ok) log_warning(LOG_IMPORTANT, "Cannot %s a selection of %u elements", grow ? "propagate":"shrink", GridSel_size(this));
+	if (r.queue) mem_unregister(r.queue);
+	GridSel_destruct(&r.region);
+	GridSel_destruct(&r.visited);
+	return ok;
 }
-
@@ -21,19 +21,25 @@
 #include "libmicromodel/vertex.h"
 #include "libmicromodel/facet.h"
 #include "libmicromodel/grid.h"
+#include "grid.h"
 #include "rules.h"
 
 /* Private Functions */
 
 /* Public Functions */
 
+EdgeAttr *Edge_attr(const Edge *this) {
+	assert(this);
+	return ElmntTable_row(Grid_table(GridSel_EDGE), EDGE_ATTRS, this->name);
+}
+
 int Edge_construct(Edge *this, unsigned name, Vertex *v1, Vertex *v2) {
 	assert(this && v1 && v2);
 	this->name = name;
 	this->v[SOUTH] = v1;
 	this->v[NORTH] = v2;
 	this->facets[0] = this->facets[1] = NULL;
-	this->normal_ok = false;
+	Edge_attr(this)->normal_gen = 0;
 	return 1;
 }
 
@@ -42,9 +48,18 @@ int Edge_destruct(Edge *this) {
 	return 1;
 }
 
+static void Edge_invalidate_around(Edge *this) {
+	// a vertex of this edge changed : so did the loops of its facets and the rings of its vertices
+	for (EdgePole p=SOUTH; p<NB_POLES; p++) Vertex_invalidate_normal(this->v[p]);
+	for (EdgeSide s=WEST; s<NB_SIDES; s++) {
+		if (this->facets[s]) Facet_invalidate_normal(this->facets[s]);
+	}
+}
+
 void Edge_add_facet(Edge *this, Facet *facet, EdgeSide side) {
 	assert(this && facet && (side==WEST || side==EAST));
-	this->normal_ok = false;
+	Edge_attr(this)->normal_gen = 0;
+	Grid_topology_changed();
 	this->facets[side] = facet;
 	if (this->facets[!side]) {
 		Vertex_add_edge(this->v[0], this);
@@ -54,7 +69,8 @@ void Edge_add_facet(Edge *this, Facet *facet, EdgeSide side) {
 
 void Edge_change_facet(Edge *this, Facet *from, Facet *to) {
 	assert(this && from && to);
-	this->normal_ok = false;
+	Edge_attr(this)->normal_gen = 0;
+	Grid_topology_changed();
 	if (this->facets[WEST] == from) {
 		assert(this->facets[EAST]!=from && this->facets[EAST]!=to);
 		this->facets[WEST] = to;
@@ -67,7 +83,9 @@ void Edge_change_facet(Edge *this, Facet *from, Facet *to) {
 /* Does NOT signal to vertices */
 void Edge_change_vertex(Edge *this, Vertex *from, Vertex *to) {
 	assert(this && from && to);
-	this->normal_ok = false;
+	Edge_attr(this)->normal_gen = 0;
+	Grid_topology_changed();
+	Grid_unindex_edge(this);
 	if (this->v[SOUTH] == from) {
 		assert(this->v[NORTH]!=from && this->v[SOUTH]!=to);
 		this->v[SOUTH] = to;
@@ -75,19 +93,28 @@ void Edge_change_vertex(Edge *this, Vertex *from, Vertex *to) {
 		assert(this->v[NORTH]==from && this->v[SOUTH]!=to);
 		this->v[NORTH] = to;
 	}
+	Grid_index_edge(this);
+	Vertex_invalidate_normal(from);
+	Edge_invalidate_around(this);
 }
 
 /* Does NOT signal to vertices */
 void Edge_set_vertex(Edge *this, EdgePole pole, Vertex *new) {
 	assert(this && new);
 	assert(this->v[pole]);
-	this->normal_ok = false;
+	Edge_attr(this)->normal_gen = 0;
+	Grid_topology_changed();
+	Vertex_invalidate_normal(this->v[pole]);
+	Grid_unindex_edge(this);
 	this->v[pole] = new;
+	Grid_index_edge(this);
+	Edge_invalidate_around(this);
 }
 
 void Edge_remove_facet(Edge *this, Facet *facet) {
 	assert(this && facet);
-	this->normal_ok = false;
+	Edge_attr(this)->normal_gen = 0;
+	Grid_topology_changed();
 	if (this->facets[WEST] == facet) {
 		this->facets[WEST] = NULL;
 	} else {
@@ -99,12 +126,16 @@ void Edge_remove_facet(Edge *this, Facet *facet) {
 void Edge_cut(Edge *this, Edge *new, Vertex *v) {
 	assert(this && v);
 	assert(rule_e3(this));
-	this->normal_ok = false;
+	Edge_attr(this)->normal_gen = 0;
+	Grid_topology_changed();
 	new->facets[WEST] = this->facets[WEST];
 	new->facets[EAST] = this->facets[EAST];
 	// update connections
 	Vertex_change_connection(this->v[NORTH], this, new);
+	Grid_unindex_edge(this);
 	this->v[NORTH] = v;
+	Grid_index_edge(this);
+	Edge_invalidate_around(this);
 	// init V's connections
 	Vertex_add_edge(v, this);
 	Vertex_add_edge(v, new);
@@ -146,16 +177,23 @@ Vertex *Edge_get_vertex(const Edge *this, EdgePole pole) {
 const Vec *Edge_normal(Edge *this) {
 	assert(this);
 	assert(rule_e2(this));
-	if (this->normal_ok) return &this->normal;
-	Vec_add3(&this->normal, Facet_normal(this->facets[0]), Facet_normal(this->facets[1]));
-	Vec_normalize(&this->normal);
-	this->normal_ok = true;
-	return &this->normal;
+	unsigned gen = Grid_normals_generation();
+	if (Edge_attr(this)->normal_gen == gen) return &Edge_attr(this)->normal;
+	Vec_add3(&Edge_attr(this)->normal, Facet_normal(this->facets[0]), Facet_normal(this->facets[1]));
+	Vec_normalize(&Edge_attr(this)->normal);
+	Edge_attr(this)->normal_gen = gen;
+	return &Edge_attr(this)->normal;
+}
+
+void Edge_invalidate_normal(Edge *this) {
+	assert(this);
+	Edge_attr(this)->normal_gen = 0;
 }
 
 double Edge_length(Edge *this) {
 	assert(this);
-	return Vec_dist(Vertex_position(this->v[0]), Vertex_position(this->v[1]));
+	Vec p0, p1;
+	return Vec_dist(Vertex_get_position(this->v[0], &p0), Vertex_get_position(this->v[1], &p1));
 }
 
 /* Friends */
@@ -167,4 +205,15 @@ bool edges_are_connected(Edge *e0, Edge *e1) {
 		(e0->v[NORTH]!=NULL && (e0->v[NORTH]==e1->v[SOUTH] || e0->v[NORTH]==e1->v[NORTH]));
 }
 
+void Edge_relocate(Edge *this, Vertex *const *vertices, Facet *const *facets) {
+	// Our vertices and facets were moved ; the arrays give their new location, indexed by their former names
+	assert(this && vertices && facets);
+	for (EdgePole p=SOUTH; p<NB_POLES; p++) {
+		if (this->v[p]) this->v[p] = vertices[Vertex_name(this->v[p])];
+	}
+	for (EdgeSide s=WEST; s<NB_SIDES; s++) {
+		if (this->facets[s]) this->facets[s] = facets[Facet_name(this->facets[s])];
+	}
+}
+
 // vi:ts=3:sw=3
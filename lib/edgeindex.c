@@ -0,0 +1,157 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "../config.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <libcnt/mem.h>
+#include "edgeindex.h"
+
+#define EDGEINDEX_MIN_SLOTS 64
+
+/* Private Functions */
+
+static void key(const Vertex *k[2], const Vertex *v1, const Vertex *v2) {
+	if ((uintptr_t)v1 < (uintptr_t)v2) {
+		k[0] = v1; k[1] = v2;
+	} else {
+		k[0] = v2; k[1] = v1;
+	}
+}
+
+static unsigned slot_of(const EdgeIndex *this, const Vertex *const k[2]) {
+	uint64_t h = (uint64_t)(uintptr_t)k[0] * 0x9E3779B97F4A7C15ULL;
+	h ^= (uint64_t)(uintptr_t)k[1] * 0xC2B2AE3D27D4EB4FULL;
+	h ^= h >> 29;
+	return (unsigned)h & (this->nb_slots-1);
+}
+
+static void put(EdgeIndex *this, const Vertex *const k[2], Edge *edge) {
+	unsigned s = slot_of(this, k);
+	while (this->slots[s].edge) s = (s+1) & (this->nb_slots-1);
+	this->slots[s].v[0] = k[0];
+	this->slots[s].v[1] = k[1];
+	this->slots[s].edge = edge;
+	this->nb_edges ++;
+}
+
+static int EdgeIndex_resize(EdgeIndex *this, unsigned nb_slots) {
+	EdgeIndexSlot *old = this->slots;
+	unsigned old_nb = this->nb_slots;
+	this->slots = mem_alloc(nb_slots * sizeof(*this->slots));
+	if (! this->slots) {
+		this->slots = old;
+		return 0;
+	}
+	memset(this->slots, 0, nb_slots * sizeof(*this->slots));
+	this->nb_slots = nb_slots;
+	this->nb_edges = 0;
+	// start from a free slot, so that the duplicates are put back in the same order
+	unsigned start = 0;
+	while (start < old_nb && old[start].edge) start ++;
+	for (unsigned i=0; i<old_nb; i++) {
+		EdgeIndexSlot *slot = &old[(start+i) & (old_nb-1)];
+		if (slot->edge) put(this, slot->v, slot->edge);
+	}
+	if (old) mem_unregister(old);
+	return 1;
+}
+
+/* Public Functions */
+
+void EdgeIndex_construct(EdgeIndex *this) {
+	assert(this);
+	this->ok = true;
+	this->nb_slots = this->nb_edges = 0;
+	this->slots = NULL;
+}
+
+void EdgeIndex_destruct(EdgeIndex *this) {
+	assert(this);
+	if (this->slots) mem_unregister(this->slots);
+	EdgeIndex_construct(this);
+}
+
+void EdgeIndex_clear(EdgeIndex *this) {
+	// keep the slots for what's built next
+	assert(this);
+	if (this->slots) memset(this->slots, 0, this->nb_slots * sizeof(*this->slots));
+	this->nb_edges = 0;
+	this->ok = true;
+}
+
+int EdgeIndex_add(EdgeIndex *this, Edge *edge) {
+	assert(this && edge);
+	if (! this->ok) return 0;
+	if (2*(this->nb_edges+1) > this->nb_slots) {
+		if (! EdgeIndex_resize(this, this->nb_slots ? 2*this->nb_slots : EDGEINDEX_MIN_SLOTS)) {
+			this->ok = false;
+			return 0;
+		}
+	}
+	const Vertex *k[2];
+	key(k, Edge_get_vertex(edge, SOUTH), Edge_get_vertex(edge, NORTH));
+	put(this, k, edge);
+	return 1;
+}
+
+void EdgeIndex_remove(EdgeIndex *this, Edge *edge) {
+	// with its current vertices, that must be the ones it was added with
+	assert(this && edge);
+	if (! this->ok) return;
+	const Vertex *k[2];
+	key(k, Edge_get_vertex(edge, SOUTH), Edge_get_vertex(edge, NORTH));
+	unsigned mask = this->nb_slots-1;
+	unsigned s = slot_of(this, k);
+	while (this->slots[s].edge != edge) {
+		assert(this->slots[s].edge);
+		s = (s+1) & mask;
+	}
+	// shift back the following slots that would not be found anymore
+	unsigned hole = s;
+	for (s = (s+1) & mask; this->slots[s].edge; s = (s+1) & mask) {
+		unsigned home = slot_of(this, this->slots[s].v);
+		if (((s - home) & mask) >= ((s - hole) & mask)) {
+			this->slots[hole] = this->slots[s];
+			hole = s;
+		}
+	}
+	this->slots[hole].edge = NULL;
+	this->nb_edges --;
+}
+
+Edge *EdgeIndex_get(const EdgeIndex *this, const Vertex *v1, const Vertex *v2) {
+	assert(this && this->ok);
+	if (! this->nb_edges) return NULL;
+	const Vertex *k[2];
+	key(k, v1, v2);
+	unsigned s = slot_of(this, k);
+	for (; this->slots[s].edge; s = (s+1) & (this->nb_slots-1)) {
+		if (this->slots[s].v[0] == k[0] && this->slots[s].v[1] == k[1]) return this->slots[s].edge;
+	}
+	return NULL;
+}
+void EdgeIndex_stats(const EdgeIndex *this, GridMemStats *stats) {
+	assert(this && stats);
+	stats->nb_elmnts = this->nb_edges;
+	stats->capacity = this->nb_slots;
+	stats->bytes = this->nb_slots * sizeof(*this->slots);
+	stats->used = this->nb_edges * sizeof(*this->slots);
+}
+
+// vi:ts=3:sw=3
@@ -0,0 +1,53 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef EDGEINDEX_H_060410
+#define EDGEINDEX_H_060410
+
+/* The edges of a grid, found by their two vertices in whatever order.
+ * Open addressing with linear probing ; several edges may link the same
+ * vertices for a while (flat facets waiting to be removed), the first one
+ * added is found first.
+ */
+
+#include <stdbool.h>
+#include "libmicromodel/vertex.h"
+#include "libmicromodel/edge.h"
+#include "libmicromodel/grid.h"
+
+typedef struct EdgeIndexSlot {
+	const Vertex *v[2];	// lowest address first
+	Edge *edge;	// NULL if the slot is free
+} EdgeIndexSlot;
+
+typedef struct EdgeIndex {
+	bool ok;	// false once an edge could not be added : the index is then not to be trusted
+	unsigned nb_slots;	// a power of 2, or 0
+	unsigned nb_edges;
+	EdgeIndexSlot *slots;
+} EdgeIndex;
+
+void EdgeIndex_construct(EdgeIndex *this);
+void EdgeIndex_destruct(EdgeIndex *this);
+void EdgeIndex_clear(EdgeIndex *this);
+int EdgeIndex_add(EdgeIndex *this, Edge *edge);
+void EdgeIndex_remove(EdgeIndex *this, Edge *edge);
+Edge *EdgeIndex_get(const EdgeIndex *this, const Vertex *v1, const Vertex *v2);
+void EdgeIndex_stats(const EdgeIndex *this, GridMemStats *stats);
+
+#endif
+// vi:ts=3:sw=3
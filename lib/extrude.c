@@ -85,7 +85,8 @@ static GridSel extrude_zone(GridSel *this, bool dir_vertex, Vec *direction, doub
 						vn[p] = value->vertex;
 						en[p] = value->edge;
 					} else {
-						vn[p] = Grid_vertex_new(Vertex_position(v), v->basis, v->skin_ratio, v->uv_x, v->uv_y);
+						Vec position;
+						vn[p] = Grid_vertex_new(Vertex_get_position(v, &position), Vertex_basis(v), Vertex_skin_ratio(v), Vertex_uv_x(v), Vertex_uv_y(v));
 						en[p] = Grid_edge_new(vn[p], v);
 						hValue new_value = { .vertex=vn[p], .edge=en[p], .normal=*Vertex_normal(v) };
 						if (!cntHash_put(h, key, &new_value)) assert(0);
@@ -139,11 +140,14 @@ static GridSel extrude_zone(GridSel *this, bool dir_vertex, Vec *direction, doub
 			Vec_scale(&dir, ratio);
 		}
 		while ( (v=GridSel_each(&vertices)) ) {
-			Vec_add(Vertex_position(v), &dir);
+			Vec position;
+			Vec_add(Vertex_get_position(v, &position), &dir);
+			Vertex_set_position(v, &position);
+			Vertex_moved(v);
 		}
 	} else if (dir_vertex) {
 		while ( (v=GridSel_each(&vertices)) ) {
-			Vec dir;
+			Vec dir, position;
 			hValue *hv = cntHash_get(h, (cntHashkey){ .ptr = v });
 			if (hv) {
 				dir = hv->normal;
@@ -151,11 +155,14 @@ static GridSel extrude_zone(GridSel *this, bool dir_vertex, Vec *direction, doub
 				dir = *Vertex_normal(v);
 			}
 			Vec_scale(&dir, ratio);
-			Vec_add(Vertex_position(v), &dir);
+			Vec_add(Vertex_get_position(v, &position), &dir);
+			Vertex_set_position(v, &position);
+			Vertex_moved(v);
 		}
 	} else {
 		Vec normals[GridSel_size(&vertices)];
 		unsigned n = 0;
+		GridSel_update_facets(this);
 		while ( (v=GridSel_each(&vertices)) ) {
 			normals[n] = vec_origin;
 			for (unsigned i=0; i<Vertex_size(v); i++) {
@@ -172,7 +179,10 @@ static GridSel extrude_zone(GridSel *this, bool dir_vertex, Vec *direction, doub
 		n = 0;
 		GridSel_reset(&vertices);
 		while ( (v=GridSel_each(&vertices)) ) {
-			Vec_add(Vertex_position(v), normals+n);
+			Vec position;
+			Vec_add(Vertex_get_position(v, &position), normals+n);
+			Vertex_set_position(v, &position);
+			Vertex_moved(v);
 			n++;
 		}
 	}
@@ -20,88 +20,77 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
-#include <libcnt/shelf.h>
+#include <string.h>
 #include <libcnt/log.h>
 #include "libmicromodel/grid.h"
 #include "libmicromodel/facet.h"
 #include "libmicromodel/edge.h"
 #include "libmicromodel/vertex.h"
+#include "grid.h"
 #include "rules.h"
+#include "normals.h"
 
 /* Data Definitions */
 
-static cntShelf *facetEdges = NULL;
-
+// Edges are stored in direct order, with the side of the edge the facet is on
 typedef struct FacetEdge {
 	Edge *edge;
-	struct FacetEdge *next;
+	EdgeSide side;
 } FacetEdge;
 
 /* Private Functions */
 
-static void facetEdges_end(void) {
-	if (facetEdges) {
-		cntShelf_del(facetEdges);
-		facetEdges = NULL;
-	}
+static int Facet_reserve(Facet *this, unsigned size) {
+	assert(this);
+	if (size <= Facet_attr(this)->capacity) return 1;
+	unsigned new_capacity = Facet_attr(this)->capacity ? Facet_attr(this)->capacity : 4;
+	while (new_capacity < size) new_capacity <<= 1;
+	FacetEdge *tmp = Grid_alloc(this->facetEdges, Facet_attr(this)->capacity*sizeof(*tmp), new_capacity*sizeof(*tmp));
+	if (!tmp) return 0;
+	this->facetEdges = tmp;
+	Facet_attr(this)->capacity = new_capacity;
+	return 1;
 }
 
-static int facetEdges_init(void) {
-	if (facetEdges) return 1;
-	facetEdges = cntShelf_new(sizeof(FacetEdge), Grid_get_carac_size()*4);
-	atexit(facetEdges_end);
-	return NULL != facetEdges;
+static inline Vertex *FacetEdge_first_vertex(const FacetEdge *fe) {
+	return Edge_get_vertex(fe->edge, WEST==fe->side ? SOUTH : NORTH);
+}
+
+static unsigned Facet_edge_order(const Facet *this, const Edge *edge) {
+	unsigned i;
+	for (i=0; i<this->size; i++) {
+		if (this->facetEdges[i].edge == edge) break;
+	}
+	return i;
 }
 
 // Check internal data structure, not topology
 static bool Facet_is_valid(Facet *this) {
 	assert(this);
-	// Check the FacetEdges list
-	FacetEdge *fe = this->first_facetEdge;
-	for (unsigned i=0; i<this->size; i++) {
-		fe = fe->next;	// TODO we should also check that the same edge or facetEdge is not used twice
+	if (this->size > Facet_attr(this)->capacity) return false;
+	if (this->size && !this->facetEdges) return false;
+	for (unsigned i=0; i<this->size; i++) {	// TODO we should also check that the same edge is not used twice
+		if (!this->facetEdges[i].edge) return false;
 	}
-	if (fe != this->first_facetEdge) return false;
 	return true;
 }
 
 static void Facet_sub_hear(Facet *this, unsigned start, unsigned stop, Edge *edge) {
-	// Replace every edges from order start to stop by the Edge edge
+	// Replace every edges from order start to stop by the Edge edge, which becomes the first one
 	assert(this && start!=stop && start<this->size && stop<this->size && edge);
-	this->normal_ok = false;
-	FacetEdge *new_fe = cntShelf_alloc(facetEdges);
-	assert(new_fe);
-	new_fe->edge = edge;
-	unsigned i = 0;
-	FacetEdge *fe = this->first_facetEdge, *next_fe;
-	if (start < stop) {
-		for ( ; i < this->size; i++, fe=next_fe) {
-			next_fe = fe->next;
-			if (i+1 == start || (this->size-1 == i && 0 == start)) {
-				fe->next = new_fe;
-			} else if (i >= start && i < stop) {
-				cntShelf_free(facetEdges, fe);
-			} else if (i == stop) {
-				new_fe->next = fe;
-			} else if (i > stop && start > 0) {
-				break;
-			}
-		}
-		this->size -= stop - start - 1;
-	} else {
-		for ( ; i < this->size; i++, fe=next_fe) {
-			next_fe = fe->next;
-			if (i < stop || i >= start) {
-				cntShelf_free(facetEdges, fe);
-			} else if (i == stop) {
-				new_fe->next = fe;
-			} else if (i+1 == start) {
-				fe->next = new_fe;
-			}
-		}
-		this->size = start - stop + 1;
+	Facet_invalidate_normal(this);	// with the edges that go away
+	Grid_topology_changed();
+	unsigned const nb_kept = (start + this->size - stop) % this->size;
+	FacetEdge kept[nb_kept];
+	for (unsigned k=0, i=stop; k<nb_kept; k++) {
+		kept[k] = this->facetEdges[i];
+		if (++ i >= this->size) i = 0;
 	}
-	this->first_facetEdge = new_fe;
+	this->facetEdges[0].edge = edge;
+	this->facetEdges[0].side = Facet_my_side(this, edge);
+	memcpy(this->facetEdges+1, kept, nb_kept*sizeof(*kept));
+	this->size = nb_kept + 1;
+	Facet_invalidate_normal(this);
 	assert(Facet_is_valid(this));
 }
 
@@ -121,61 +110,37 @@ int Facet_construct(Facet *this, unsigned name, unsigned size, Edge **edges, boo
 	// The edges are given in direct order, and must have their right vertices already ;
 	// they are informed of their new relationship with this facet.
 	assert(this);
-	if (!facetEdges_init()) return 0;
 	this->name = name;
-	this->size = size;
-	this->normal_ok = false;
-	FacetEdge *previous = NULL;
-	Edge *first_edge = NULL;
+	this->size = 0;
+	Facet_attr(this)->normal_gen = 0;
+	Facet_attr(this)->capacity = 0;
+	this->facetEdges = NULL;
 	if (!size) return 1;	// as a special case, we accept empty facets
-	int i_start, i_end, i_inc;
-	if (direct) {
-		i_start = 0;
-		i_end = size;
-		i_inc = 1;
-	} else {
-		i_start = size-1;
-		i_end = -1;
-		i_inc = -1;
+	if (!Facet_reserve(this, size)) return 0;
+	this->size = size;
+	for (unsigned i=0; i<size; i++) {
+		this->facetEdges[i].edge = edges[direct ? i : size-1-i];
 	}
-	for (int i=i_start; i != i_end+i_inc; i += i_inc) {
-		Edge *edge;
-		FacetEdge *fe;
-		if (i != i_end) {
-			edge = edges[i];
-			fe = cntShelf_alloc(facetEdges);
-			assert(fe);
-			fe->edge = edge;
-		} else {	// looping
-			edge = first_edge;
-			fe = this->first_facetEdge;
-			assert(previous);
-		}
-		if (!previous) {
-			first_edge = edge;
-			this->first_facetEdge = fe;
+	for (unsigned i=0; i<size; i++) {
+		FacetEdge *previous = &this->facetEdges[i];
+		Edge *edge = this->facetEdges[i+1<size ? i+1 : 0].edge;
+		/* So, what side was previous on ?
+		 * Edges are passed in direct order, so that If last vertex of previous segment = a vertex of current = NORTH,
+		 * then previous was directed toward direct rotation, and so facet is WEST side.
+		 */
+		if (
+			Edge_get_vertex(previous->edge, NORTH) == Edge_get_vertex(edge, SOUTH) ||
+			Edge_get_vertex(previous->edge, NORTH) == Edge_get_vertex(edge, NORTH)
+		) {
+			previous->side = WEST;
 		} else {
-			previous->next = fe;
-			EdgeSide previous_side;
-			/* So, what side was previous on ?
-			 * Edges are passed in direct order, so that If last vertex of previous segment = a vertex of current = NORTH,
-			 * then previous was directed toward direct rotation, and so facet is WEST side.
-			 */
-			if (
-				Edge_get_vertex(previous->edge, NORTH) == Edge_get_vertex(edge, SOUTH) ||
-				Edge_get_vertex(previous->edge, NORTH) == Edge_get_vertex(edge, NORTH)
-			) {
-				previous_side = WEST;
-			} else {
-				assert(
-					Edge_get_vertex(previous->edge, SOUTH) == Edge_get_vertex(edge, SOUTH) ||
-					Edge_get_vertex(previous->edge, SOUTH) == Edge_get_vertex(edge, NORTH)
-				);
-				previous_side = EAST;
-			}
-			Edge_add_facet(previous->edge, this, previous_side);
+			assert(
+				Edge_get_vertex(previous->edge, SOUTH) == Edge_get_vertex(edge, SOUTH) ||
+				Edge_get_vertex(previous->edge, SOUTH) == Edge_get_vertex(edge, NORTH)
+			);
+			previous->side = EAST;
 		}
-		previous = fe;
+		Edge_add_facet(previous->edge, this, previous->side);
 	}
 	assert(Facet_is_valid(this));
 	return 1;
@@ -183,45 +148,33 @@ int Facet_construct(Facet *this, unsigned name, unsigned size, Edge **edges, boo
 
 int Facet_destruct(Facet *this) {
 	assert(this);
-	FacetEdge *first_fe = this->first_facetEdge;
-	if (!first_fe) return 1;
-	FacetEdge *fe = first_fe;
-	do {
-		void *to_free = fe;
-		fe = fe->next;
-		cntShelf_free(facetEdges, to_free);
-	} while (fe != first_fe);
+	if (this->facetEdges) {
+		Grid_free(this->facetEdges, Facet_attr(this)->capacity*sizeof(*this->facetEdges));
+		this->facetEdges = NULL;
+	}
+	this->size = 0;
 	return 1;
 }
 
 void Facet_add_edge_next(Facet *this, Edge *restrict edge, Edge *restrict new) {
 	assert(this && edge && new);
-	this->normal_ok = false;
-	unsigned i;
-	FacetEdge *previous_fe = NULL, *fe = this->first_facetEdge;
-	for (i=0; i<this->size; i++) {
-		if (fe->edge == edge) break;
-		previous_fe = fe;
-		fe = fe->next;
-	}
+	Grid_topology_changed();
+	unsigned i = Facet_edge_order(this, edge);
 	assert(i<this->size);
-	FacetEdge *new_fe = cntShelf_alloc(facetEdges);
-	assert(new_fe);
-	new_fe->edge = new;
+	if (!Facet_reserve(this, this->size+1)) {
+		log_warning(LOG_IMPORTANT, "Cannot grow facet %u", this->name);
+		return;
+	}
 	// did new comes before or after edge ?
-	Vertex *v = Facet_get_vertex(this, i);	// first - for us - vertex of edge
-	if (Edge_get_vertex(new, SOUTH) == v || Edge_get_vertex(new, NORTH) == v) {	// new is before edge
-		new_fe->next = fe;
-		if (!previous_fe) {
-			for (i=0, previous_fe=this->first_facetEdge; i<this->size-1; i++) previous_fe = previous_fe->next;
-			this->first_facetEdge = new_fe;
-		}
-		previous_fe->next = new_fe;
-	} else {	// new is after edge
-		new_fe->next = fe->next;
-		fe->next = new_fe;
+	Vertex *v = FacetEdge_first_vertex(&this->facetEdges[i]);	// first - for us - vertex of edge
+	if (Edge_get_vertex(new, SOUTH) != v && Edge_get_vertex(new, NORTH) != v) {	// new is after edge
+		i ++;
 	}
+	memmove(this->facetEdges+i+1, this->facetEdges+i, (this->size-i)*sizeof(*this->facetEdges));
+	this->facetEdges[i].edge = new;
+	this->facetEdges[i].side = Edge_get_facet(new, WEST)==this ? WEST:EAST;
 	this->size ++;
+	Facet_invalidate_normal(this);
 	assert(Facet_is_valid(this));
 }
 
@@ -229,12 +182,15 @@ void Facet_split(Facet *restrict this, Facet *restrict new_facet, Edge *edge) {
 	// The new facet is build EASTSIDE from edge
 	assert(this && new_facet && edge);
 	assert(Facet_is_valid(this));
-	this->normal_ok = false;
+	Facet_attr(this)->normal_gen = 0;
 	// construct new_facet as an empty facet
+	if (!Facet_reserve(new_facet, 4)) {
+		log_warning(LOG_IMPORTANT, "Cannot build facet %u", new_facet->name);
+		return;
+	}
 	new_facet->size = 1;
-	new_facet->first_facetEdge = cntShelf_alloc(facetEdges);
-	new_facet->first_facetEdge->edge = edge;
-	new_facet->first_facetEdge->next = new_facet->first_facetEdge;	// enought for Facet_add_edge_next
+	new_facet->facetEdges[0].edge = edge;
+	new_facet->facetEdges[0].side = EAST;	// enought for Facet_add_edge_next
 	// get vertices
 	Vertex *v1 = Edge_get_vertex(edge, SOUTH);
 	Vertex *v2 = Edge_get_vertex(edge, NORTH);
@@ -242,7 +198,7 @@ void Facet_split(Facet *restrict this, Facet *restrict new_facet, Edge *edge) {
 	// look for v1 in this
 	unsigned i;
 	for (i=0; i<this->size; i++) {
-		if (Facet_get_vertex(this, i) == v1) break;
+		if (FacetEdge_first_vertex(&this->facetEdges[i]) == v1) break;
 	}
 	assert(i < this->size);
 	// until v2, add the edges to new_facet
@@ -250,13 +206,13 @@ void Facet_split(Facet *restrict this, Facet *restrict new_facet, Edge *edge) {
 	Edge *e = edge;
 	unsigned i1 = i;
 	do {
-		Edge *e_ = Facet_get_edge(this, i);
+		Edge *e_ = this->facetEdges[i].edge;
 		assert(e_);
 		Edge_change_facet(e_, this, new_facet);
 		Facet_add_edge_next(new_facet, e, e_);
 		e = e_;
 		if (++ i >= this->size) i = 0;
-		v = Facet_get_vertex(this, i);
+		v = FacetEdge_first_vertex(&this->facetEdges[i]);
 	} while (v != v2);
 	// Now that's done, signal this and new_facet to edge (wich will signal to vertices)
 	Edge_add_facet(edge, this, WEST);
@@ -269,21 +225,16 @@ void Facet_split(Facet *restrict this, Facet *restrict new_facet, Edge *edge) {
 
 void Facet_change_edge(Facet *this, Edge *restrict old, Edge *restrict new, int inverse_side) {
 	assert(this && old && new);
-	this->normal_ok = false;
-	FacetEdge *fe = this->first_facetEdge;
-	assert(fe);
-	unsigned i;
-	for (i=0; i<this->size; i++) {
-		if (fe->edge == old) {
-			EdgeSide side = Facet_my_side(this, old);
-			Edge_remove_facet(old, this);
-			fe->edge = new;
-			Edge_add_facet(new, this, inverse_side ? !side : side);
-			break;
-		}
-		fe = fe->next;
-	}
+	Facet_attr(this)->normal_gen = 0;
+	unsigned i = Facet_edge_order(this, old);
 	assert(i<this->size);
+	FacetEdge *fe = &this->facetEdges[i];
+	EdgeSide side = Facet_my_side(this, old);
+	Edge_remove_facet(old, this);
+	fe->edge = new;
+	fe->side = inverse_side ? !side : side;
+	Edge_add_facet(new, this, fe->side);
+	Facet_invalidate_normal(this);
 	assert(Facet_is_valid(this));
 }
 
@@ -303,20 +254,13 @@ int Facet_remove_if_flat(Facet *this) {
 void Facet_remove_edge(Facet *this, Edge *edge) {
 	assert(this && edge);
 	assert(rule_f1(this));
-	this->normal_ok = false;
-	FacetEdge *fe = this->first_facetEdge;
-	if (fe->edge == edge) this->first_facetEdge = fe->next;
-	unsigned i;
-	for (i=0; i<this->size; i++, fe=fe->next) {
-		if (fe->next->edge == edge) {
-			FacetEdge *tmp = fe->next->next;
-			cntShelf_free(facetEdges, fe->next);
-			fe->next = tmp;
-			break;
-		}
-	}
+	Facet_invalidate_normal(this);	// with the edge that goes away
+	Grid_topology_changed();
+	unsigned i = Facet_edge_order(this, edge);
 	assert(i < this->size);
 	this->size --;
+	memmove(this->facetEdges+i, this->facetEdges+i+1, (this->size-i)*sizeof(*this->facetEdges));
+	Facet_invalidate_normal(this);
 	assert(Facet_is_valid(this));
 }
 
@@ -325,23 +269,19 @@ unsigned Facet_size(const Facet *this) {
 	return this->size;
 }
 
+FacetAttr *Facet_attr(const Facet *this) {
+	assert(this);
+	return ElmntTable_row(Grid_table(GridSel_FACET), FACET_ATTRS, this->name);
+}
 
 Edge *Facet_get_edge(const Facet *this, unsigned order) {
 	assert(this && order<this->size);
-	FacetEdge *fe = this->first_facetEdge;
-	for (unsigned i=0; i<order; i++) {
-		fe = fe->next;
-	}
-	return fe->edge;
+	return this->facetEdges[order].edge;
 }
 
 Vertex *Facet_get_vertex(const Facet *this, unsigned order) {
 	assert(this && order < this->size);
-	FacetEdge *fe = this->first_facetEdge;
-	for (unsigned i=0; i<order; i++) {
-		fe = fe->next;
-	}
-	return Edge_get_vertex(fe->edge, Edge_get_facet(fe->edge, WEST)==this ? SOUTH : NORTH);
+	return FacetEdge_first_vertex(&this->facetEdges[order]);
 }
 
 Facet *Facet_get_facet(const Facet *this, unsigned order) {
@@ -350,44 +290,43 @@ Facet *Facet_get_facet(const Facet *this, unsigned order) {
 	return Edge_get_facet(edge, !Facet_my_side(this, edge));
 }
 
+static void Facet_update(Facet *this) {
+	// same computation than Grid_update_normals, the first corner being the reference
+	Vec pos[Facet_size(this)+1];
+	for (unsigned i=0; i<Facet_size(this); i++) Vertex_get_position(Facet_get_vertex(this, i), pos+i+1);
+	pos[0] = Facet_size(this) ? pos[1] : vec_origin;
+	Facet_attr(this)->area = .5 * Normal_of_loop(&Facet_attr(this)->normal, pos, Facet_size(this)+1, false);
+	Center_of_loop(&Facet_attr(this)->center, pos, Facet_size(this)+1);
+	Facet_attr(this)->normal_gen = Grid_normals_generation();
+}
+
 const Vec *Facet_normal(Facet *this) {
 	assert(this);
-	if (this->normal_ok) return &this->normal;
-	this->normal_ok = true;
-	this->normal = vec_origin;
-	if (Facet_size(this)<3) return &this->normal;
-	const Vec *pos_ref = Vertex_position(Facet_get_vertex(this, 0));
-	Vec pos[2];
-	pos[1] = *Vertex_position(Facet_get_vertex(this, 1));
-	Vec_sub(&pos[1], pos_ref);
-	Vec_normalize(&pos[1]);
-	for (unsigned i=2; i<Facet_size(this); i++) {
-		pos[0] = pos[1];
-		pos[1] = *Vertex_position(Facet_get_vertex(this, i));
-		Vec_sub(&pos[1], pos_ref);
-		Vec_normalize(&pos[1]);
-		Vec tmp;
-		Vec_product(&tmp, &pos[0], &pos[1]);
-		Vec_add(&this->normal, &tmp);
-	}
-	Vec_normalize(&this->normal);
-	return &this->normal;
+	if (Facet_attr(this)->normal_gen != Grid_normals_generation()) Facet_update(this);
+	return &Facet_attr(this)->normal;
 }
 
 void Facet_invalidate_normal(Facet *this) {
+	// also the normals of the edges and vertices, that are computed from this one
 	assert(this);
-	this->normal_ok = false;
+	Facet_attr(this)->normal_gen = 0;
+	for (unsigned i=0; i<Facet_size(this); i++) {
+		Edge_invalidate_normal(Facet_get_edge(this, i));
+		Vertex_invalidate_normal(Facet_get_vertex(this, i));
+	}
 }
 
 const Vec *Facet_center(Facet *this) {
+	// valid until the facet or one of its vertices changes
 	assert(this);
-	static Vec center;
-	Vec_construct(&center, 0.,0.,0.);
-	for (unsigned i=0; i<Facet_size(this); i++) {
-		Vec_add(&center, Vertex_position(Facet_get_vertex(this, i)));
-	}
-	Vec_scale(&center, 1./Facet_size(this));
-	return &center;
+	if (Facet_attr(this)->normal_gen != Grid_normals_generation()) Facet_update(this);
+	return &Facet_attr(this)->center;
+}
+
+double Facet_area(Facet *this) {
+	assert(this);
+	if (Facet_attr(this)->normal_gen != Grid_normals_generation()) Facet_update(this);
+	return Facet_attr(this)->area;
 }
 
 void Facet_swallow_by_edge(Facet *this, Edge *edge) {
@@ -397,4 +336,25 @@ void Facet_swallow_by_edge(Facet *this, Edge *edge) {
 	// TODO
 }
 
+void Facet_relocate(Facet *this, Edge *const *edges) {
+	// Same as Vertex_relocate
+	assert(this && edges);
+	FacetEdge *old = this->facetEdges;
+	unsigned old_capacity = Facet_attr(this)->capacity;
+	this->facetEdges = NULL;
+	Facet_attr(this)->capacity = 0;
+	if (this->size && !Facet_reserve(this, this->size)) {
+		this->facetEdges = old;
+		Facet_attr(this)->capacity = old_capacity;
+	} else if (old) {
+		memcpy(this->facetEdges, old, this->size*sizeof(*old));
+		Grid_free(old, old_capacity*sizeof(*old));
+	}
+	for (unsigned i=0; i<this->size; i++) {
+		FacetEdge *fe = &this->facetEdges[i];
+		fe->edge = edges[Edge_name(fe->edge)];
+		assert(fe->edge);
+	}
+}
+
 // vi:ts=3:sw=3
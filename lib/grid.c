@@ -21,6 +21,8 @@
 #include <assert.h>
 #include <math.h>
 #include <stdarg.h>
+#include <string.h>
+#include <limits.h>
 #include <libcnt/cnt.h>
 #include <libcnt/hash.h>
 #include <libcnt/list.h>
@@ -32,8 +34,16 @@
 #include "libmicromodel/edge.h"
 #include "libmicromodel/basis.h"
 #include "libmicromodel/color.h"
+#include "libmicromodel/halfedge.h"
 #include "gridsel.h"
 #include "grid.h"
+#include "table.h"
+#include "arena.h"
+#include "normals.h"
+#include "edgeindex.h"
+#include "bvh.h"
+#include "incidence.h"
+#include "rules.h"
 
 #define GRID_VERSION 0
 
@@ -41,20 +51,32 @@
 
 struct Grid {
 	cntHash *selections;	// clefs unsigned, pour les selections, valeurs = GridSel
-	cntHash *vertices;	// clefs = unsigned, valeurs = Vertex
-	cntHash *edges;
-	cntHash *facets;
+	GridSelHolders holders;	// selections of each element
+	ElmntTable vertices;	// indexed by name
+	ElmntTable edges;
+	ElmntTable facets;
+	Arena arena;	// connection arrays and cold parts of the elements
 	cntHash *bases;
 	cntHash *colors;
-	unsigned next_vertex, next_edge, next_facet, next_basis;
+	unsigned topology_version;	// incremented whenever an element or a connection changes
+	unsigned normals_generation;	// cached normals of another generation are to be recomputed
+	NormalBatch normals;	// for Grid_update_normals
+	EdgeIndex edge_index;	// edges by their vertices
+	unsigned geometry_version;	// incremented whenever a vertex moves, or the topology changes
+	BVH bvh;	// facets by location, fitted to some geometry version
+	Incidence incidence;	// element incidences, of some topology version
+	size_t memory_high_water[NB_GRID_MEMS];	// bytes, kept when the grid is cleared
+	HalfEdges *half_edges;	// allocated by the first Grid_half_edge_view
+	GridIter cursors[3];	// for Grid_reset_X/Grid_each_X, by GridSel_type
+	unsigned selection_cursor;	// selections already given by Grid_each_selection
 };
 
-static Grid *this_grid = NULL;
-static unsigned carac_size = 2000;
+static PER_THREAD Grid *this_grid = NULL;
+static PER_THREAD unsigned carac_size = 2000;
 
 /* Private Functions */
 
-static void Grid_destruct(void) {
+static void Grid_destruct(bool keep_chunks) {
 	assert(this_grid);
 	void *ptr;
 	if (this_grid->selections) {
@@ -65,26 +87,27 @@ static void Grid_destruct(void) {
 		}
 		cntHash_del(this_grid->selections);
 	}
-	if (this_grid->vertices) {
-		cntHash_reset(this_grid->vertices);
-		while (cntHash_each(this_grid->vertices, NULL, &ptr)) {
-			Vertex_destruct(ptr);
-		}
-		cntHash_del(this_grid->vertices);
-	}
-	if (this_grid->edges) {
-		cntHash_reset(this_grid->edges);
-		while (cntHash_each(this_grid->edges, NULL, &ptr)) {
-			Edge_destruct(ptr);
-		}
-		cntHash_del(this_grid->edges);
-	}
-	if (this_grid->facets) {
-		cntHash_reset(this_grid->facets);
-		while (cntHash_each(this_grid->facets, NULL, &ptr)) {
-			Facet_destruct(ptr);
-		}
-		cntHash_del(this_grid->facets);
+	// elements only use memory from the grid's chunks, so they need not be destructed one by one
+	if (keep_chunks) {
+		ElmntTable_clear(&this_grid->vertices);
+		ElmntTable_clear(&this_grid->edges);
+		ElmntTable_clear(&this_grid->facets);
+		Arena_clear(&this_grid->arena);
+		NormalBatch_clear(&this_grid->normals, false);
+		EdgeIndex_clear(&this_grid->edge_index);
+		BVH_clear(&this_grid->bvh);
+		Incidence_clear(&this_grid->incidence);
+		GridSelHolders_clear(&this_grid->holders);
+	} else {
+		ElmntTable_destruct(&this_grid->vertices);
+		ElmntTable_destruct(&this_grid->edges);
+		ElmntTable_destruct(&this_grid->facets);
+		Arena_destruct(&this_grid->arena);
+		NormalBatch_destruct(&this_grid->normals);
+		EdgeIndex_destruct(&this_grid->edge_index);
+		BVH_destruct(&this_grid->bvh);
+		Incidence_destruct(&this_grid->incidence);
+		GridSelHolders_destruct(&this_grid->holders);
 	}
 	if (this_grid->bases) {
 		cntHash_reset(this_grid->bases);
@@ -100,27 +123,46 @@ static void Grid_destruct(void) {
 		}
 		cntHash_del(this_grid->colors);
 	}
+	if (this_grid->half_edges) {
+		HalfEdges_destruct(this_grid->half_edges);
+		mem_unregister(this_grid->half_edges);
+		this_grid->half_edges = NULL;
+	}
 }
 
-static int Grid_construct(void) {	// build an empty (invalid) grid
+static int Grid_construct(bool reuse_chunks) {	// build an empty (invalid) grid
 	assert(this_grid);
-	this_grid->selections = this_grid->vertices = this_grid->edges = this_grid->facets = NULL;
-	this_grid->next_vertex = this_grid->next_edge = this_grid->next_facet = 0;
+	this_grid->selections = this_grid->bases = this_grid->colors = NULL;
+	if (! reuse_chunks) {
+		ElmntTable_construct(&this_grid->vertices, sizeof(Vertex), Grid_get_carac_size());
+		ElmntTable_construct(&this_grid->edges, sizeof(Edge), Grid_get_carac_size());
+		ElmntTable_construct(&this_grid->facets, sizeof(Facet), Grid_get_carac_size());
+		ElmntTable_add_column(&this_grid->vertices, sizeof(Position));
+		ElmntTable_add_column(&this_grid->vertices, sizeof(VertexAttr));
+		ElmntTable_add_column(&this_grid->edges, sizeof(EdgeAttr));
+		ElmntTable_add_column(&this_grid->facets, sizeof(FacetAttr));
+		Arena_construct(&this_grid->arena, 8 * Grid_get_carac_size() * sizeof(VertexEdge));
+		NormalBatch_construct(&this_grid->normals);
+		EdgeIndex_construct(&this_grid->edge_index);
+		BVH_construct(&this_grid->bvh, &this_grid->facets);
+		Incidence_construct(&this_grid->incidence, &this_grid->vertices, &this_grid->edges, &this_grid->facets);
+		GridSelHolders_construct(&this_grid->holders);
+		for (GridMem m=0; m<NB_GRID_MEMS; m++) this_grid->memory_high_water[m] = 0;
+	}
+	this_grid->topology_version = 1;	// half-edge tables start at 0 : not built yet
+	this_grid->normals_generation = 1;	// elements start at 0 : not computed yet
+	this_grid->geometry_version = 1;	// the BVH starts at 0 : not built yet
+	this_grid->half_edges = NULL;
+	this_grid->selection_cursor = 0;
 	this_grid->selections = cntHash_new(sizeof(GridSel), 50, 1, cntHash_INTKEYS, 0);
 	if (! this_grid->selections) goto fail;
-	this_grid->vertices = cntHash_new(sizeof(Vertex), Grid_get_carac_size(), 3, cntHash_INTKEYS, 0);
-	if (! this_grid->vertices) goto fail;
-	this_grid->edges = cntHash_new(sizeof(Edge), Grid_get_carac_size(), 3, cntHash_INTKEYS, 0);
-	if (! this_grid->edges) goto fail;
-	this_grid->facets = cntHash_new(sizeof(Facet), Grid_get_carac_size(), 3, cntHash_INTKEYS, 0);
-	if (! this_grid->facets) goto fail;
 	this_grid->bases = cntHash_new(sizeof(Basis), 25, 3, cntHash_INTKEYS, 0);
 	if (! this_grid->bases) goto fail;
 	this_grid->colors = cntHash_new(sizeof(Color), 35, 3, cntHash_INTKEYS, 0);
 	if (! this_grid->colors) goto fail;
 	return 1;
 fail:
-	Grid_destruct();
+	Grid_destruct(false);
 	return 0;
 }
 
@@ -141,21 +183,21 @@ static void *get_elmnt_from_index(GridSel_type type, unsigned index) {
 	return NULL;	// avoir warning
 }
 
+static void restore_selection_cursor(void) {
+	// after an internal walk of the selections, so that Grid_each_selection goes on where it was
+	cntHash_reset(this_grid->selections);
+	for (unsigned s=0; s<this_grid->selection_cursor; s++) {
+		if (! cntHash_each(this_grid->selections, NULL, NULL)) break;
+	}
+}
+
 static int add_or_sub_two_selections(unsigned name_dest, unsigned name_src, int add) {
 	assert(this_grid);
 	if (0==name_dest || 0==name_src) return 1;
 	GridSel *sel_src = Grid_get_selection(name_src);
 	GridSel *sel_dest = Grid_get_selection(name_dest);
 	assert (sel_src && sel_dest);
-	GridSel tmp; bool tmp_used = false;
-	if (sel_src->type != sel_dest->type) {
-		GridSel_convert(sel_src, &tmp, sel_dest->type, GridSel_MIN);
-		tmp_used = true;
-		sel_src = &tmp;
-	}
-	GridSel_add_or_sub(sel_dest, sel_src, add);
-	if (tmp_used) GridSel_destruct(&tmp);
-	return 1;
+	return GridSel_add_or_sub(sel_dest, sel_src, add);
 }
 
 /*
@@ -174,6 +216,7 @@ GridSel *Grid_new_selection_(unsigned name, GridSel_type type) {
 		cntHash_remove(this_grid->selections, key);
 		return NULL;
 	}
+	GridSel_attach(sel, &this_grid->holders, name);
 	return sel;
 }
 
@@ -182,16 +225,14 @@ void output_selection(unsigned selection, GridSel *sel, unsigned result_selectio
 	if (! result_selection) {
 		GridSel_destruct(my_result);
 	} else if (result_selection == selection) {
-		GridSel_destruct(sel);
-		*sel = *my_result;
+		GridSel_move(sel, my_result);
 	} else {
 		GridSel *res = Grid_get_selection(result_selection);
 		if (! res) {
 			res = Grid_new_selection_(result_selection, my_result->type);
 			assert(res);
 		}
-		GridSel_destruct(res);
-		*res = *my_result;
+		GridSel_move(res, my_result);
 	}
 }
 
@@ -200,6 +241,58 @@ GridSel *Grid_get_selection(unsigned name) {
 	return cntHash_get(this_grid->selections, (cntHashkey){ .i = name });
 }
 
+void Grid_topology_changed(void) {
+	// the normals are outdated by the elements that changed, for their own ring only
+	if (! this_grid) return;
+	this_grid->topology_version ++;
+	Grid_geometry_changed();
+}
+
+unsigned Grid_topology_version(void) {
+	assert(this_grid);
+	return this_grid->topology_version;
+}
+
+void Grid_geometry_changed(void) {
+	// a vertex moved : the BVH must be refitted
+	if (! this_grid) return;
+	if (++ this_grid->geometry_version == 0) this_grid->geometry_version = 1;
+}
+
+const BVH *Grid_bvh(void) {
+	// up to date with the current geometry
+	assert(this_grid);
+	if (! BVH_update(&this_grid->bvh, this_grid->geometry_version)) return NULL;
+	return &this_grid->bvh;
+}
+
+const Incidence *Grid_incidence(bool build) {
+	// up to date with the current topology, or NULL if not built and build is false
+	assert(this_grid);
+	if (this_grid->incidence.version != this_grid->topology_version) {
+		if (! build || ! Incidence_build(&this_grid->incidence, this_grid->topology_version)) return NULL;
+	}
+	return &this_grid->incidence;
+}
+
+void Grid_index_edge(Edge *edge) {
+	// to be called once the edge has its vertices, and again whenever they change
+	if (! this_grid || ! this_grid->edge_index.ok) return;
+	if (! EdgeIndex_add(&this_grid->edge_index, edge)) {
+		log_warning(LOG_IMPORTANT, "Cannot index edge %u, vertices will be scanned for their edges", Edge_name(edge));
+	}
+}
+
+void Grid_unindex_edge(Edge *edge) {
+	// before its vertices change
+	if (this_grid) EdgeIndex_remove(&this_grid->edge_index, edge);
+}
+
+unsigned Grid_normals_generation(void) {
+	assert(this_grid);
+	return this_grid->normals_generation;
+}
+
 /*
  * Public Functions
  */
@@ -207,15 +300,27 @@ GridSel *Grid_get_selection(unsigned name) {
 int Grid_new(void) {	// alloc an empty (invalid) Grid
 	this_grid = mem_alloc(sizeof(*this_grid));
 	if (! this_grid) return 0;
-	if (! Grid_construct()) {
+	if (! Grid_construct(false)) {
+		mem_unregister(this_grid);
+		this_grid = NULL;
+		return 0;
+	}
+	return 1;
+}
+int Grid_clear(void) {	// empty the grid, but keep its memory for what is built next
+	assert(this_grid);
+	Grid_memory_stats(NULL);	// the high water marks are kept
+	Grid_destruct(true);
+	if (! Grid_construct(true)) {
 		mem_unregister(this_grid);
+		this_grid = NULL;
 		return 0;
 	}
 	return 1;
 }
 
 void Grid_set(Grid *this) {
-	assert(this);
+	// NULL detaches the current grid from this thread, so that another one can use it
 	this_grid = this;
 }
 Grid *Grid_get(void) {
@@ -230,77 +335,211 @@ void Grid_set_carac_size(unsigned new_size) {
 unsigned Grid_get_carac_size(void) {
 	return carac_size;
 }
+const HalfEdges *Grid_half_edge_view(void) {
+	// Half-edge tables of the current grid, rebuild if the topology changed since
+	if (!this_grid) return NULL;
+	if (!this_grid->half_edges) {
+		this_grid->half_edges = mem_alloc(sizeof(*this_grid->half_edges));
+		if (!this_grid->half_edges) return NULL;
+		HalfEdges_construct(this_grid->half_edges);
+	}
+	HalfEdges *he = this_grid->half_edges;
+	if (he->version != this_grid->topology_version) {
+		if (!HalfEdges_build(he, this_grid->topology_version)) return NULL;
+	}
+	return he;
+}
 
 Vertex *Grid_vertex_new(const Vec *position, unsigned bi, float ratio, float uv_x, float uv_y) {
 	// Add an unlinked vertex, return its number
 	assert(this_grid && position && (bi>0 || ratio==0.));
-	Vertex *v = cntHash_put(this_grid->vertices, (cntHashkey){ .i = this_grid->next_vertex }, NULL);
-	assert(v);
-	if (! Vertex_construct(v, this_grid->next_vertex, position, bi, ratio, uv_x, uv_y)) return NULL;
-	this_grid->next_vertex ++;
+	unsigned name;
+	Vertex *v = ElmntTable_new(&this_grid->vertices, &name);
+	if (! v) return NULL;
+	if (! Vertex_construct(v, name, position, bi, ratio, uv_x, uv_y)) {
+		ElmntTable_remove(&this_grid->vertices, name);
+		return NULL;
+	}
+	Grid_topology_changed();
 	return v;
 }
 Vertex *Grid_vertex_average_new(const Vertex *v1, const Vertex *v2, double ratio) {
 	assert(v1 && v2);
-	Vertex *v = cntHash_put(this_grid->vertices, (cntHashkey){ .i = this_grid->next_vertex }, NULL);
-	assert(v);
-	if (! Vertex_construct_average(v, this_grid->next_vertex, v1, v2, ratio)) return NULL;
-	this_grid->next_vertex ++;
+	unsigned name;
+	Vertex *v = ElmntTable_new(&this_grid->vertices, &name);
+	if (! v) return NULL;
+	if (! Vertex_construct_average(v, name, v1, v2, ratio)) {
+		ElmntTable_remove(&this_grid->vertices, name);
+		return NULL;
+	}
+	Grid_topology_changed();
 	return v;
 }
 Edge *Grid_edge_new(Vertex *v1, Vertex *v2) {
 	// Add an edge between two vertex. No facets are updated
 	assert(this_grid && v1 && v2);
-	Edge *e = cntHash_put(this_grid->edges, (cntHashkey){ .i = this_grid->next_edge }, NULL);
-	assert(e);
-	Edge_construct(e, this_grid->next_edge, v1, v2);
-	this_grid->next_edge ++;
+	unsigned name;
+	Edge *e = ElmntTable_new(&this_grid->edges, &name);
+	if (! e) return NULL;
+	if (! Edge_construct(e, name, v1, v2)) {
+		ElmntTable_remove(&this_grid->edges, name);
+		return NULL;
+	}
+	Grid_index_edge(e);
+	Grid_topology_changed();
 	return e;
 }
 Facet *Grid_facet_new(unsigned size, Edge **edges, bool direct) {
 	// Add a facet, using given edges
 	assert(this_grid);
-	Facet *f = cntHash_put(this_grid->facets, (cntHashkey){ .i = this_grid->next_facet }, NULL);
-	assert(f);
-	Facet_construct(f, this_grid->next_facet, size, edges, direct);
-	this_grid->next_facet ++;
+	unsigned name;
+	Facet *f = ElmntTable_new(&this_grid->facets, &name);
+	if (! f) return NULL;
+	if (! Facet_construct(f, name, size, edges, direct)) {
+		ElmntTable_remove(&this_grid->facets, name);
+		return NULL;
+	}
+	Grid_topology_changed();
 	return f;
 }
 
 void Grid_del(void) {
 	assert(this_grid);
-	Grid_destruct();
+	Grid_destruct(false);
 	mem_unregister(this_grid);
 	this_grid = NULL;
 }
 void Grid_size(unsigned *nb_vertices, unsigned *nb_edges, unsigned *nb_facets) {
-	if (nb_vertices) *nb_vertices = this_grid ? cntHash_size(this_grid->vertices) : 0;
-	if (nb_edges) *nb_edges = this_grid ? cntHash_size(this_grid->edges) : 0;
-	if (nb_facets) *nb_facets = this_grid ? cntHash_size(this_grid->facets) : 0;
+	if (nb_vertices) *nb_vertices = this_grid ? ElmntTable_size(&this_grid->vertices) : 0;
+	if (nb_edges) *nb_edges = this_grid ? ElmntTable_size(&this_grid->edges) : 0;
+	if (nb_facets) *nb_facets = this_grid ? ElmntTable_size(&this_grid->facets) : 0;
+}
+int Grid_update_facets(GridIter *facets) {
+	// normal, center and area of the facets given by this iterator, if outdated
+	assert(this_grid && facets);
+	NormalBatch *batch = &this_grid->normals;
+	Facet *f;
+	NormalBatch_clear(batch, true);
+	while ( (f = GridIter_next(facets)) ) {
+		if (! NormalBatch_add_facet(batch, f)) return 0;
+	}
+	NormalBatch_compute(batch);
+	NormalBatch_store_facets(batch);
+	return 1;
+}
+void Grid_update_edges(GridIter *edges) {
+	// outdated normals of the edges given by this iterator, from the normals of their facets
+	// that must be up to date already (see Grid_update_facets)
+	assert(this_grid && edges);
+	unsigned const gen = this_grid->normals_generation;
+	Edge *e;
+	while ( (e = GridIter_next(edges)) ) {
+		EdgeAttr *attr = Edge_attr(e);
+		if (attr->normal_gen == gen || ! rule_e2(e)) continue;
+		const FacetAttr *west = Facet_attr(Edge_get_facet(e, WEST)), *east = Facet_attr(Edge_get_facet(e, EAST));
+		if (west->normal_gen != gen || east->normal_gen != gen) continue;	// left to Edge_normal
+		Vec_add3(&attr->normal, &west->normal, &east->normal);
+		Vec_normalize(&attr->normal);
+		attr->normal_gen = gen;
+	}
+}
+int Grid_update_vertices(GridIter *vertices) {
+	// outdated normals of the vertices given by this iterator
+	assert(this_grid && vertices);
+	NormalBatch *batch = &this_grid->normals;
+	Vertex *v;
+	NormalBatch_clear(batch, false);
+	while ( (v = GridIter_next(vertices)) ) {
+		if (! NormalBatch_add_vertex(batch, v)) return 0;
+	}
+	NormalBatch_compute(batch);
+	NormalBatch_store_vertices(batch);
+	return 1;
+}
+void Grid_update_normals(void) {
+	// Recompute every outdated normal, facets first since the edges normals are made of them,
+	// in one pass over packed positions. Afterward, X_normal() are mere reads.
+	// Whatever could not be packed is left outdated, to be computed when read.
+	assert(this_grid);
+	GridIter facets = Grid_iter(GridSel_FACET);
+	if (! Grid_update_facets(&facets)) return;
+	GridIter edges = Grid_iter(GridSel_EDGE);
+	Grid_update_edges(&edges);
+	GridIter vertices = Grid_iter(GridSel_VERTEX);
+	(void)Grid_update_vertices(&vertices);
+}
+
+static const char *memory_names[NB_GRID_MEMS] = {
+	"vertices", "edges", "facets", "connections", "edge index", "normals", "BVH", "half-edges", "incidence", "selections"
+};
+
+const char *Grid_memory_name(GridMem mem) {
+	assert(mem < NB_GRID_MEMS);
+	return memory_names[mem];
+}
+
+void Grid_memory_stats(GridMemStats stats[NB_GRID_MEMS]) {
+	// stats may be NULL, just to keep the high water marks up to date
+	assert(this_grid);
+	GridMemStats tmp[NB_GRID_MEMS];
+	if (! stats) stats = tmp;
+	memset(stats, 0, NB_GRID_MEMS * sizeof(*stats));
+	ElmntTable_stats(&this_grid->vertices, stats+GridMem_VERTICES);
+	ElmntTable_stats(&this_grid->edges, stats+GridMem_EDGES);
+	ElmntTable_stats(&this_grid->facets, stats+GridMem_FACETS);
+	Arena_stats(&this_grid->arena, stats+GridMem_CONNECTIONS);
+	EdgeIndex_stats(&this_grid->edge_index, stats+GridMem_EDGE_INDEX);
+	NormalBatch_stats(&this_grid->normals, stats+GridMem_NORMALS);
+	BVH_stats(&this_grid->bvh, stats+GridMem_BVH);
+	if (this_grid->half_edges) HalfEdges_stats(this_grid->half_edges, stats+GridMem_HALF_EDGES);
+	Incidence_stats(&this_grid->incidence, stats+GridMem_INCIDENCE);
+	cntHash_reset(this_grid->selections);
+	void *ptr;
+	while (cntHash_each(this_grid->selections, NULL, &ptr)) {
+		GridSel_stats(ptr, stats+GridMem_SELECTIONS);
+	}
+	restore_selection_cursor();
+	GridSelHolders_stats(&this_grid->holders, stats+GridMem_SELECTIONS);
+	for (GridMem m=0; m<NB_GRID_MEMS; m++) {
+		if (stats[m].bytes > this_grid->memory_high_water[m]) this_grid->memory_high_water[m] = stats[m].bytes;
+		stats[m].high_water = this_grid->memory_high_water[m];
+	}
+}
+
+unsigned Grid_validate(GridReport *report, bool thorough) {
+	// Check the rules on every element, without stopping at the first violation.
+	// Returns how many there are, and the first ones in report.
+	assert(this_grid && report);
+	return Rules_check(&this_grid->vertices, &this_grid->edges, &this_grid->facets, thorough, report);
 }
 
 void Grid_replace_vertex(Vertex *v, Vertex *rep) {
 	assert(this_grid && v);
-	Vertex_destruct(v);
-	int ret = cntHash_remove_by_address(this_grid->vertices, v);
-	assert(ret);
+	unsigned name = Vertex_name(v);
+	// while its name can still be read
 	Grid_replace_in_selections(GridSel_VERTEX, v, rep);
+	Vertex_destruct(v);
+	ElmntTable_remove(&this_grid->vertices, name);
+	Grid_topology_changed();
 }
 
 void Grid_replace_edge(Edge *e, Edge *rep) {
 	assert(this_grid && e);
-	Edge_destruct(e);
-	int ret = cntHash_remove_by_address(this_grid->edges, e);
-	assert(ret);
+	unsigned name = Edge_name(e);
 	Grid_replace_in_selections(GridSel_EDGE, e, rep);
+	Grid_unindex_edge(e);
+	Edge_destruct(e);
+	ElmntTable_remove(&this_grid->edges, name);
+	Grid_topology_changed();
 }
 
 void Grid_replace_facet(Facet *f, Vertex *rep) {
 	assert(this_grid && f);
-	Facet_destruct(f);
-	int ret = cntHash_remove_by_address(this_grid->facets, f);
-	assert(ret);
+	unsigned name = Facet_name(f);
 	Grid_replace_in_selections(GridSel_FACET, f, rep);
+	Facet_destruct(f);
+	ElmntTable_remove(&this_grid->facets, name);
+	Grid_topology_changed();
 }
 
 Edge *Grid_edge_cut(Edge *edge, double ratio) {
@@ -317,6 +556,16 @@ Edge *Grid_edge_cut(Edge *edge, double ratio) {
 	return new;
 }
 
+void *Grid_alloc(void *ptr, size_t old_size, size_t new_size) {
+	// (re)allocate memory for an element of the current grid (freed with the grid)
+	assert(this_grid);
+	return Arena_realloc(&this_grid->arena, ptr, old_size, new_size);
+}
+void Grid_free(void *ptr, size_t size) {
+	assert(this_grid);
+	Arena_free(&this_grid->arena, ptr, size);
+}
+
 /* Homotetic Functions */
 
 static void scale(Vec *pos, Vec *axis, double ratio) {
@@ -497,8 +746,8 @@ int Grid_plane_cut(unsigned selection, unsigned result_selection, Vec *center, V
 	Edge *edge;
 	while ( (edge = GridSel_each(&edge_sel)) ) {
 		Vec ps, pn;
-		Vec_sub3(&ps, Vertex_position(Edge_get_vertex(edge, SOUTH)), center);
-		Vec_sub3(&pn, Vertex_position(Edge_get_vertex(edge, NORTH)), center);
+		Vec_sub(Vertex_get_position(Edge_get_vertex(edge, SOUTH), &ps), center);
+		Vec_sub(Vertex_get_position(Edge_get_vertex(edge, NORTH), &pn), center);
 		double ss = Vec_scalar(&ps, normal);
 		double sn = Vec_scalar(&pn, normal);
 		const double ss_sn = ss*sn;
@@ -533,27 +782,25 @@ int Grid_zap(unsigned selection) {
 	GridSel *sel = Grid_get_selection(selection);
 	if (! sel) return 0;
 	GridSel tmp_sel;
-	switch (sel->type) {
-		case GridSel_FACET:
-			GridSel_convert(sel, &tmp_sel, GridSel_VERTEX, GridSel_MIN);
-			GridSel_destruct(sel);
-			*sel = tmp_sel;	// copied, so its like tmp_sel was never constructed
-			// pass
-		case GridSel_VERTEX:
-			GridSel_reset(sel);
-			Vertex *v;
-			while ( (v=GridSel_each(sel)) ) {
-				Vertex_zap(v);
-			};
-			break;
-		case GridSel_EDGE:
-			GridSel_reset(sel);
-			Edge *e;
-			while ( (e=GridSel_each(sel)) ) {
-				Edge_zap(e);
-			};
-			break;
+	if (sel->type == GridSel_FACET) {
+		GridSel_convert(sel, &tmp_sel, GridSel_VERTEX, GridSel_MIN);
+		GridSel_move(sel, &tmp_sel);
+		GridSel_destruct(&tmp_sel);
+	}
+	// the zapped elements are replaced in sel by their neighbours, which are not to be zapped in turn
+	GridSel_construct(&tmp_sel, sel->type);
+	if (! GridSel_add_or_sub(&tmp_sel, sel, true)) {
+		GridSel_destruct(&tmp_sel);
+		return 0;
+	}
+	GridSel_reset(&tmp_sel);
+	void *elmnt;
+	while ( (elmnt=GridSel_each(&tmp_sel)) ) {
+		if (! GridSel_selected(sel, elmnt)) continue;
+		if (sel->type == GridSel_VERTEX) Vertex_zap(elmnt);
+		else Edge_zap(elmnt);
 	}
+	GridSel_destruct(&tmp_sel);
 	GridSel_clear(sel);
 	return 1;
 }
@@ -616,6 +863,169 @@ int Grid_separate(unsigned name, unsigned result_selection) {
 	return 1;
 }
 
+/* Compaction */
+
+struct compaction {
+	ElmntTable vertices, edges, facets;
+	Vertex **new_vertex;	// indexed by former names
+	Edge **new_edge;
+	Facet **new_facet;
+};
+
+static bool compact_vertex(struct compaction *c, Vertex *v) {
+	if (! v || c->new_vertex[Vertex_name(v)]) return true;
+	unsigned name;
+	Vertex *new = ElmntTable_new(&c->vertices, &name);
+	if (! new) return false;
+	*new = *v;
+	new->name = name;
+	ElmntTable_copy_rows(&c->vertices, name, &this_grid->vertices, Vertex_name(v));
+	c->new_vertex[Vertex_name(v)] = new;
+	return true;
+}
+
+static bool compact_edge(struct compaction *c, Edge *e) {
+	if (c->new_edge[Edge_name(e)]) return true;
+	unsigned name;
+	Edge *new = ElmntTable_new(&c->edges, &name);
+	if (! new) return false;
+	*new = *e;
+	new->name = name;
+	ElmntTable_copy_rows(&c->edges, name, &this_grid->edges, Edge_name(e));
+	c->new_edge[Edge_name(e)] = new;
+	return true;
+}
+
+static bool compact_facet(struct compaction *c, Facet *f) {
+	assert(! c->new_facet[Facet_name(f)]);
+	unsigned name;
+	Facet *new = ElmntTable_new(&c->facets, &name);
+	if (! new) return false;
+	*new = *f;
+	new->name = name;
+	ElmntTable_copy_rows(&c->facets, name, &this_grid->facets, Facet_name(f));
+	c->new_facet[Facet_name(f)] = new;
+	return true;
+}
+
+static void *compacted(struct compaction *c, GridSel_type type, void *elmnt) {
+	switch (type) {
+		case GridSel_VERTEX:
+			return c->new_vertex[Vertex_name(elmnt)];
+		case GridSel_EDGE:
+			return c->new_edge[Edge_name(elmnt)];
+		case GridSel_FACET:
+			return c->new_facet[Facet_name(elmnt)];
+	}
+	assert(0);
+	return NULL;
+}
+
+static void compact_selections(struct compaction *c) {
+	cntHash_reset(this_grid->selections);
+	void *ptr;
+	while (cntHash_each(this_grid->selections, NULL, &ptr)) {
+		GridSel *const sel = ptr;
+		GridSel new_sel;
+		GridSel_construct(&new_sel, sel->type);
+		GridSel_reset(sel);
+		void *elmnt;
+		while ( (elmnt = GridSel_each(sel)) ) {
+			GridSel_add(&new_sel, compacted(c, sel->type, elmnt));
+		}
+		GridSel_move(sel, &new_sel);
+	}
+}
+
+int Grid_compact(void) {
+	// Renumber all elements from 0, and store them contiguously in topological order.
+	// Selections, bases and colors are kept (bases and colors do not refer to elements).
+	if (! this_grid) return 0;
+	Grid_memory_stats(NULL);	// before the old tables go
+	struct compaction c;
+	ElmntTable_construct_like(&c.vertices, &this_grid->vertices);
+	ElmntTable_construct_like(&c.edges, &this_grid->edges);
+	ElmntTable_construct_like(&c.facets, &this_grid->facets);
+	unsigned nb_facets = ElmntTable_size(&this_grid->facets);
+	c.new_vertex = mem_alloc((this_grid->vertices.next_name+1) * sizeof(*c.new_vertex));
+	c.new_edge = mem_alloc((this_grid->edges.next_name+1) * sizeof(*c.new_edge));
+	c.new_facet = mem_alloc((this_grid->facets.next_name+1) * sizeof(*c.new_facet));
+	Facet **queue = mem_alloc((nb_facets+1) * sizeof(*queue));
+	bool ok = c.new_vertex && c.new_edge && c.new_facet && queue;
+	if (ok) {
+		memset(c.new_vertex, 0, this_grid->vertices.next_name * sizeof(*c.new_vertex));
+		memset(c.new_edge, 0, this_grid->edges.next_name * sizeof(*c.new_edge));
+		memset(c.new_facet, 0, this_grid->facets.next_name * sizeof(*c.new_facet));
+	}
+	// facets breadth first, each followed by its vertices and edges
+	unsigned head = 0, tail = 0, n = 0;
+	Facet *f;
+	while (ok && (f = ElmntTable_next(&this_grid->facets, &n, UINT_MAX))) {
+		if (c.new_facet[Facet_name(f)]) continue;
+		ok = compact_facet(&c, f);
+		queue[tail++] = f;
+		while (ok && head < tail) {
+			f = queue[head++];
+			for (unsigned o=0; ok && o<Facet_size(f); o++) {
+				ok = compact_vertex(&c, Facet_get_vertex(f, o)) && compact_edge(&c, Facet_get_edge(f, o));
+				Facet *next = Facet_get_facet(f, o);
+				if (ok && next && ! c.new_facet[Facet_name(next)]) {
+					ok = compact_facet(&c, next);
+					queue[tail++] = next;
+				}
+			}
+		}
+	}
+	// then the remaining edges and vertices
+	Edge *e;
+	n = 0;
+	while (ok && (e = ElmntTable_next(&this_grid->edges, &n, UINT_MAX))) {
+		ok = compact_vertex(&c, Edge_get_vertex(e, SOUTH)) && compact_vertex(&c, Edge_get_vertex(e, NORTH)) && compact_edge(&c, e);
+	}
+	Vertex *v;
+	n = 0;
+	while (ok && (v = ElmntTable_next(&this_grid->vertices, &n, UINT_MAX))) {
+		ok = compact_vertex(&c, v);
+	}
+	if (! ok) {
+		log_warning(LOG_IMPORTANT, "Cannot compact the grid");
+		ElmntTable_destruct(&c.vertices);
+		ElmntTable_destruct(&c.edges);
+		ElmntTable_destruct(&c.facets);
+		goto quit;
+	}
+	compact_selections(&c);
+	// the copies take the place of the old elements, whose tables go into c, so that
+	// their columns are found by their new names
+	ElmntTable old;
+	old = this_grid->vertices; this_grid->vertices = c.vertices; c.vertices = old;
+	old = this_grid->edges; this_grid->edges = c.edges; c.edges = old;
+	old = this_grid->facets; this_grid->facets = c.facets; c.facets = old;
+	// now make the copies point to each others (old elements are still readable)
+	n = 0;
+	while ( (v = ElmntTable_next(&this_grid->vertices, &n, UINT_MAX)) ) Vertex_relocate(v, c.new_edge);
+	n = 0;
+	while ( (e = ElmntTable_next(&this_grid->edges, &n, UINT_MAX)) ) Edge_relocate(e, c.new_vertex, c.new_facet);
+	n = 0;
+	while ( (f = ElmntTable_next(&this_grid->facets, &n, UINT_MAX)) ) Facet_relocate(f, c.new_edge);
+	// the old elements gave their connections to the copies, so must not be destructed
+	ElmntTable_destruct(&c.vertices);
+	ElmntTable_destruct(&c.edges);
+	ElmntTable_destruct(&c.facets);
+	EdgeIndex_clear(&this_grid->edge_index);
+	n = 0;
+	while ( (e = ElmntTable_next(&this_grid->edges, &n, UINT_MAX)) ) Grid_index_edge(e);
+	BVH_clear(&this_grid->bvh);	// names changed
+	Grid_topology_changed();
+	if (++ this_grid->normals_generation == 0) this_grid->normals_generation = 1;	// every element was copied
+quit:
+	if (c.new_vertex) mem_unregister(c.new_vertex);
+	if (c.new_edge) mem_unregister(c.new_edge);
+	if (c.new_facet) mem_unregister(c.new_facet);
+	if (queue) mem_unregister(queue);
+	return ok;
+}
+
 /* Selection Manipulation */
 
 int Grid_new_selection(unsigned name, GridSel_type type) {
@@ -643,10 +1053,9 @@ int Grid_addsingle_to_selection(unsigned name, unsigned index) {
 	if (! this_grid || ! name) return 0;
 	GridSel *sel = Grid_get_selection(name);
 	assert(sel);
-	cntHashkey key = { .ptr = get_elmnt_from_index(sel->type, index) };
-	if (key.ptr) {
-		cntHash_put(sel->elmnts, key, NULL);
-		return 1;
+	void *elmnt = get_elmnt_from_index(sel->type, index);
+	if (elmnt) {
+		return NULL != GridSel_add(sel, elmnt);
 	} else {
 		return 0;
 	}
@@ -656,9 +1065,9 @@ int Grid_subsingle_from_selection(unsigned name, unsigned index) {
 	if (! this_grid || ! name) return 0;
 	GridSel *sel = Grid_get_selection(name);
 	assert(sel);
-	cntHashkey key = { .ptr = get_elmnt_from_index(sel->type, index) };
-	if (key.ptr) {
-		cntHash_remove(sel->elmnts, key);
+	void *elmnt = get_elmnt_from_index(sel->type, index);
+	if (elmnt) {
+		GridSel_remove(sel, elmnt);
 		return 1;
 	} else {
 		return 0;
@@ -688,8 +1097,7 @@ int Grid_convert_selection(unsigned name, GridSel_type type, GridSel_convert_typ
 	if (type == sel->type) return 1;
 	GridSel my_result;
 	GridSel_convert(sel, &my_result, type, convert_type);
-	GridSel_destruct(sel);
-	*sel = my_result;
+	GridSel_move(sel, &my_result);
 	return 1;
 }
 
@@ -701,15 +1109,110 @@ int Grid_propagate_selection(unsigned name, unsigned level) {
 	return 1;
 }
 
+int Grid_shrink_selection(unsigned name, unsigned level) {
+	if (! this_grid || ! name) return 0;
+	GridSel *sel = Grid_get_selection(name);
+	assert(sel);
+	GridSel_shrink(sel, level);
+	return 1;
+}
+
+int Grid_selection_rings(unsigned name, unsigned level, bool grow, unsigned *rings, unsigned nb_names) {
+	if (! this_grid || ! name) return 0;
+	GridSel *sel = Grid_get_selection(name);
+	assert(sel);
+	return GridSel_rings(sel, level, grow, rings, nb_names);
+}
+
+static int select_in(unsigned name, const BVHRegion *region) {
+	if (! this_grid || ! name) return 0;
+	GridSel *sel = Grid_get_selection(name);
+	if (! sel) return 0;
+	return GridSel_select_in(sel, region);
+}
+
+int Grid_select_in_box(unsigned name, const Vec *min, const Vec *max) {
+	assert(min && max);
+	BVHRegion region = { .type = BVHRegion_BOX, .a = *min, .b = *max };
+	return select_in(name, &region);
+}
+
+int Grid_select_in_sphere(unsigned name, const Vec *center, double radius) {
+	assert(center);
+	BVHRegion region = { .type = BVHRegion_SPHERE, .a = *center, .radius = radius };
+	return select_in(name, &region);
+}
+
+int Grid_select_in_halfspace(unsigned name, const Vec *point, const Vec *normal) {
+	assert(point && normal);
+	BVHRegion region = { .type = BVHRegion_HALFSPACE, .a = *point, .b = *normal };
+	return select_in(name, &region);
+}
+
+int Grid_select_in_cylinder(unsigned name, const Vec *base, const Vec *top, double radius) {
+	assert(base && top);
+	BVHRegion region = { .type = BVHRegion_CYLINDER, .a = *base, .b = *top, .radius = radius };
+	return select_in(name, &region);
+}
+
+static int select_if(unsigned name, const GridPred *pred) {
+	if (! this_grid || ! name) return 0;
+	GridSel *sel = Grid_get_selection(name);
+	if (! sel) return 0;
+	return GridSel_select_if(sel, pred);
+}
+
+int Grid_select_by_normal(unsigned name, const Vec *axis, double angle) {
+	assert(axis);
+	GridPred pred = { .type = GridPred_NORMAL, .axis = *axis, .value = cos(angle) };
+	Vec_normalize(&pred.axis);
+	return select_if(name, &pred);
+}
+
+int Grid_select_by_color(unsigned name, unsigned color) {
+	GridPred pred = { .type = GridPred_COLOR, .name = color };
+	return select_if(name, &pred);
+}
+
+int Grid_select_by_basis(unsigned name, unsigned basis) {
+	GridPred pred = { .type = GridPred_BASIS, .name = basis };
+	return select_if(name, &pred);
+}
+
+int Grid_select_by_uv(unsigned name, float min_u, float min_v, float max_u, float max_v) {
+	GridPred pred = { .type = GridPred_UV, .min_uv = { min_u, min_v }, .max_uv = { max_u, max_v } };
+	return select_if(name, &pred);
+}
+
+int Grid_select_by_length(unsigned name, double length, bool longer) {
+	GridPred pred = { .type = longer ? GridPred_LONGER : GridPred_SHORTER, .value = length };
+	return select_if(name, &pred);
+}
+
+static void replace_in_selection(GridSel *sel, void *old_elmnt, void *new_elmnt) {
+	if (GridSel_remove(sel, old_elmnt) && new_elmnt) GridSel_add(sel, new_elmnt);
+}
+
 int Grid_replace_in_selections(GridSel_type type, void *old_elmnt, void *new_elmnt) {
+	// only the selections holding old_elmnt are visited, plus those with no slot
 	if (! this_grid) return 0;
+	GridSelHolders *holders = &this_grid->holders;
+	if (holders->ok) {
+		uint64_t held = GridSelHolders_get(holders, type, GridSel_elmnt_name(type, old_elmnt));
+		while (held) {
+			GridSel *sel = Grid_get_selection(holders->names[__builtin_ctzll(held)]);
+			assert(sel && sel->type == type);
+			replace_in_selection(sel, old_elmnt, new_elmnt);
+			held &= held-1;
+		}
+		if (! holders->nb_unslotted) return 1;
+	}
 	cntHash_reset(this_grid->selections);
 	void *ptr;
 	while (cntHash_each(this_grid->selections, NULL, &ptr)) {
 		GridSel *const sel = ptr;
-		if (sel->type == type && GridSel_selected(sel, old_elmnt)) {
-			GridSel_remove(sel, old_elmnt);
-			if (new_elmnt) GridSel_add(sel, new_elmnt);
+		if (sel->type == type && (! holders->ok || sel->slot == GRIDSEL_SLOTS)) {
+			replace_in_selection(sel, old_elmnt, new_elmnt);
 		}
 	}
 	return 1;
@@ -750,9 +1253,9 @@ int Grid_del_basis(unsigned name) {
 			other_basis->is_instance = false;
 		}
 	}
-	Grid_reset_vertices();
+	GridIter it = Grid_iter(GridSel_VERTEX);
 	Vertex *v;
-	while ( (v=Grid_each_vertex()) ) {
+	while ( (v=GridIter_next(&it)) ) {
 		if (Vertex_basis(v) == name) Vertex_set_basis(v, 0, 0.);
 	}
 	return 1;
@@ -848,16 +1351,17 @@ int Grid_set_selection_color(unsigned selection, unsigned color) {
 
 Facet *Grid_get_facet(unsigned index) {
 	assert(this_grid);
-	return cntHash_get(this_grid->facets, (cntHashkey){ .i = index });
+	return ElmntTable_get(&this_grid->facets, index);
 }
 
 Edge *Grid_get_edge(unsigned index) {
 	assert(this_grid);
-	return cntHash_get(this_grid->edges, (cntHashkey){ .i = index });
+	return ElmntTable_get(&this_grid->edges, index);
 }
 
 Edge *Grid_edge_index_from_vertices(Vertex *v1, Vertex *v2) {
 	assert(v1 && v2);
+	if (this_grid && this_grid->edge_index.ok) return EdgeIndex_get(&this_grid->edge_index, v1, v2);
 	unsigned size = Vertex_size(v1);
 	for (unsigned i=0; i<size; i++) {
 		if (Vertex_get_vertex(v1, i) == v2) {
@@ -869,63 +1373,117 @@ Edge *Grid_edge_index_from_vertices(Vertex *v1, Vertex *v2) {
 
 Vertex *Grid_get_vertex(unsigned index) {
 	assert(this_grid);
-	return cntHash_get(this_grid->vertices, (cntHashkey){ .i = index });
+	return ElmntTable_get(&this_grid->vertices, index);
+}
+
+Facet *Grid_ray_facet(const Vec *origin, const Vec *dir, double *dist) {
+	// first facet hit by the half line from origin toward dir, at origin + *dist * dir
+	assert(origin && dir);
+	const BVH *bvh = Grid_bvh();
+	return bvh ? BVH_ray(bvh, origin, dir, dist) : NULL;
+}
+
+Facet *Grid_nearest_facet(const Vec *point, Vec *nearest) {
+	// facet closest to point, with its closest point in *nearest
+	assert(point);
+	const BVH *bvh = Grid_bvh();
+	return bvh ? BVH_nearest(bvh, point, nearest) : NULL;
+}
+
+const ElmntTable *Grid_table(GridSel_type type) {
+	switch (type) {
+		case GridSel_VERTEX:
+			return &this_grid->vertices;
+		case GridSel_EDGE:
+			return &this_grid->edges;
+		case GridSel_FACET:
+			return &this_grid->facets;
+	}
+	assert(0);
+	return NULL;
+}
+
+GridIter Grid_iter(GridSel_type type) {
+	// All elements of this type, including those created while iterating
+	assert(this_grid);
+	return (GridIter){ .table = Grid_table(type), .next = 0, .end = UINT_MAX, .sel = NULL };
+}
+
+GridIter Grid_iter_selection(unsigned name) {
+	assert(this_grid);
+	GridSel *sel = Grid_get_selection(name);
+	assert(sel);
+	return GridSel_iter(sel);
+}
+
+GridIter GridIter_split(const GridIter *this, unsigned nb_parts, unsigned part) {
+	// One of nb_parts ranges of names, that together cover the remaining of this
+	assert(this && nb_parts > 0 && part < nb_parts);
+	unsigned end = this->end;
+	if (end > ElmntTable_nb_names(this->table)) end = ElmntTable_nb_names(this->table);
+	unsigned length = end > this->next ? end - this->next : 0;
+	GridIter it = *this;
+	it.next = this->next + (unsigned)((unsigned long long)length * part / nb_parts);
+	it.end = this->next + (unsigned)((unsigned long long)length * (part+1) / nb_parts);
+	return it;
+}
+
+void *GridIter_next(GridIter *this) {
+	// Does not use the current grid, so can be used from any thread
+	assert(this);
+	if (! this->sel) return ElmntTable_next(this->table, &this->next, this->end);
+	while (this->next < this->end) {
+		unsigned name = GridSel_next_name(this->sel, this->next);
+		if (name >= this->end) break;
+		this->next = name+1;
+		void *elmnt = ElmntTable_get(this->table, name);
+		if (elmnt) return elmnt;
+	}
+	this->next = this->end;
+	return NULL;
 }
 
 void Grid_reset_vertices(void) {
 	assert(this_grid);
-	cntHash_reset(this_grid->vertices);
+	this_grid->cursors[GridSel_VERTEX] = Grid_iter(GridSel_VERTEX);
 }
 
 Vertex *Grid_each_vertex(void) {
 	assert(this_grid);
-	void *ptr;
-	if (cntHash_each(this_grid->vertices, NULL, &ptr)) {
-		return ptr;
-	} else {
-		return NULL;
-	}
+	return GridIter_next(&this_grid->cursors[GridSel_VERTEX]);
 }
 
 void Grid_reset_facets(void) {
 	assert(this_grid);
-	cntHash_reset(this_grid->facets);
+	this_grid->cursors[GridSel_FACET] = Grid_iter(GridSel_FACET);
 }
 
 Facet *Grid_each_facet(void) {
 	assert(this_grid);
-	void *ptr;
-	if (cntHash_each(this_grid->facets, NULL, &ptr)) {
-		return ptr;
-	} else {
-		return NULL;
-	}
+	return GridIter_next(&this_grid->cursors[GridSel_FACET]);
 }
 
 void Grid_reset_edges(void) {
 	assert(this_grid);
-	cntHash_reset(this_grid->edges);
+	this_grid->cursors[GridSel_EDGE] = Grid_iter(GridSel_EDGE);
 }
 
 Edge *Grid_each_edge(void) {
 	assert(this_grid);
-	void *ptr;
-	if (cntHash_each(this_grid->edges, NULL, &ptr)) {
-		return ptr;
-	} else {
-		return NULL;
-	}
+	return GridIter_next(&this_grid->cursors[GridSel_EDGE]);
 }
 
 void Grid_reset_selections(void) {
 	assert(this_grid);
 	cntHash_reset(this_grid->selections);
+	this_grid->selection_cursor = 0;
 }
 
 unsigned Grid_each_selection(void) {
 	assert(this_grid);
 	cntHashkey key;
 	if (cntHash_each(this_grid->selections, &key, NULL)) {
+		this_grid->selection_cursor ++;
 		return key.i;
 	} else {
 		return 0;
@@ -953,7 +1511,7 @@ void Grid_reset_selection(unsigned name) {
 	if (! name) return;
 	GridSel *sel = Grid_get_selection(name);
 	if (! sel) return;
-	cntHash_reset(sel->elmnts);
+	GridSel_reset(sel);
 }
 
 void *Grid_each_selected(unsigned name) {
@@ -20,9 +20,49 @@
 
 #include "libmicromodel/grid.h"
 #include "gridsel.h"
+#include "table.h"
+#include <stddef.h>
+
+// The columns of the element tables, for what is kept out of the elements.
+enum { VERTEX_POSITIONS, VERTEX_ATTRS };
+enum { EDGE_ATTRS };
+enum { FACET_ATTRS };
+
+// Vertex positions are packed in their column, in single precision if so configured.
+#ifdef MICROMODEL_FLOAT_POSITIONS
+typedef float Position[3];
+#else
+typedef double Position[3];
+#endif
+static inline void Position_get(const ElmntTable *vertices, unsigned name, Vec *position) {
+	const Position *p = ElmntTable_row(vertices, VERTEX_POSITIONS, name);
+	for (unsigned a=0; a<3; a++) position->c[a] = (*p)[a];
+}
+static inline void Position_set(const ElmntTable *vertices, unsigned name, const Vec *position) {
+	Position *p = ElmntTable_row(vertices, VERTEX_POSITIONS, name);
+	for (unsigned a=0; a<3; a++) (*p)[a] = position->c[a];
+}
 
 GridSel *Grid_get_selection(unsigned name);
 GridSel *Grid_new_selection_(unsigned name, GridSel_type type);
 void output_selection(unsigned selection, GridSel *sel, unsigned result_selection, GridSel *my_result);
+void Grid_topology_changed(void);
+unsigned Grid_topology_version(void);
+unsigned Grid_normals_generation(void);
+void Grid_index_edge(Edge *edge);
+void Grid_unindex_edge(Edge *edge);
+void Grid_geometry_changed(void);
+const struct BVH *Grid_bvh(void);
+const struct Incidence *Grid_incidence(bool build);
+const ElmntTable *Grid_table(GridSel_type type);
+int Grid_update_facets(GridIter *facets);
+void Grid_update_edges(GridIter *edges);
+int Grid_update_vertices(GridIter *vertices);
+void *Grid_alloc(void *ptr, size_t old_size, size_t new_size);
+void Grid_free(void *ptr, size_t size);
+
+// The current grid, and the state of whatever works on it, is per thread,
+// so that several threads can each build their own grid.
+#define PER_THREAD __thread
 
 #endif
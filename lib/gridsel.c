@@ -17,25 +17,113 @@
  */
 #include <stdbool.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <libcnt/mem.h>
+#include <libcnt/log.h>
 #include "libmicromodel/grid.h"
 #include "libmicromodel/basis.h"
 #include "libmicromodel/vertex.h"
 #include "libmicromodel/facet.h"
 #include "libmicromodel/edge.h"
 #include "gridsel.h"
+#include "grid.h"
+#include "table.h"
 
 /* Data Definitions */
 
+#define WORD_BITS 64
+
 /* Private Functions */
 
+static unsigned popcount(const uint64_t *words, unsigned nb_words) {
+	unsigned count = 0;
+	for (unsigned w=0; w<nb_words; w++) count += __builtin_popcountll(words[w]);
+	return count;
+}
+
+static uint64_t live_names(const ElmntTable *table, unsigned w) {
+	// bits of the names of this word that are elements of the table
+	uint64_t live = 0;
+	for (unsigned b=0; b<WORD_BITS; b++) {
+		if (ElmntTable_get(table, w*WORD_BITS + b)) live |= (uint64_t)1 << b;
+	}
+	return live;
+}
+
+static void hold_changes(GridSel *this, unsigned w, uint64_t old, uint64_t new) {
+	// tell the holders which names of this word were selected or unselected
+	uint64_t changed = old ^ new;
+	while (changed) {
+		unsigned b = __builtin_ctzll(changed);
+		GridSel_hold(this, w*WORD_BITS + b, new >> b & 1);
+		changed &= changed-1;
+	}
+}
+
+static unsigned expr_nb_words(const GridSelExpr *expr) {
+	// beyond which the expression has no bit set
+	unsigned l, r;
+	switch (expr->op) {
+		case GridSelExpr_SEL:
+			return expr->sel->nb_words;
+		case GridSelExpr_UNION:
+			l = expr_nb_words(expr->left);
+			r = expr_nb_words(expr->right);
+			return l > r ? l:r;
+		case GridSelExpr_DIFFERENCE:
+			return expr_nb_words(expr->left);
+		case GridSelExpr_COMPLEMENT:
+			break;
+	}
+	return (ElmntTable_nb_names(Grid_table(expr->type)) + WORD_BITS-1) / WORD_BITS;
+}
+
+static uint64_t expr_word(const GridSelExpr *expr, unsigned w) {
+	switch (expr->op) {
+		case GridSelExpr_SEL:
+			return w < expr->sel->nb_words ? expr->sel->bits[w] : 0;
+		case GridSelExpr_UNION:
+			return expr_word(expr->left, w) | expr_word(expr->right, w);
+		case GridSelExpr_DIFFERENCE:
+			return expr_word(expr->left, w) & ~expr_word(expr->right, w);
+		case GridSelExpr_COMPLEMENT:
+			break;
+	}
+	return ~expr_word(expr->left, w) & live_names(Grid_table(expr->type), w);
+}
+
+static void drop_cache(GridSel *this) {
+	if (! this->cache) return;
+	for (unsigned t=0; t<3; t++) GridSel_destruct(this->cache->expansions+t);
+	mem_unregister(this->cache);
+	this->cache = NULL;
+}
+
 /* Public Functions */
 
 int GridSel_construct(GridSel *this, GridSel_type type) {
 	assert(this && (type == GridSel_VERTEX || type == GridSel_EDGE || type == GridSel_FACET));
-	if (! (this->elmnts = cntHash_new(0, 50, 1, cntHash_PTRKEYS, 0)) ) {
-		return 0;
-	}
+	this->table = Grid_table(type);
+	this->bits = NULL;
+	this->nb_words = this->size = this->cursor = 0;
 	this->type = type;
+	this->holders = NULL;
+	this->slot = GRIDSEL_SLOTS;
+	this->version = 0;
+	this->cache = NULL;
+	return 1;
+}
+int GridSel_reserve(GridSel *this, unsigned nb_names) {
+	// room for names up to nb_names (excluded)
+	assert(this);
+	unsigned nb_words = (nb_names + WORD_BITS-1) / WORD_BITS;
+	if (nb_words <= this->nb_words) return 1;
+	if (nb_words < 2*this->nb_words) nb_words = 2*this->nb_words;
+	uint64_t *tmp = this->bits ? mem_realloc(this->bits, nb_words * sizeof(*tmp)) : mem_alloc(nb_words * sizeof(*tmp));
+	if (! tmp) return 0;
+	memset(tmp + this->nb_words, 0, (nb_words - this->nb_words) * sizeof(*tmp));
+	this->bits = tmp;
+	this->nb_words = nb_words;
 	return 1;
 }
 int GridSel_dup(GridSel *this, GridSel *source) {
@@ -45,92 +133,115 @@ int GridSel_dup(GridSel *this, GridSel *source) {
 }
 int GridSel_destruct(GridSel *this) {
 	assert(this);
-	cntHash_del(this->elmnts);
+	if (this->holders) GridSel_detach(this);
+	if (this->bits) mem_unregister(this->bits);
+	drop_cache(this);
+	this->bits = NULL;
+	this->nb_words = this->size = 0;
 	return 1;
 }
 void GridSel_reset(GridSel *this) {
 	assert(this);
-	cntHash_reset(this->elmnts);
+	this->cursor = 0;
 }
 void *GridSel_each(GridSel *this) {
+	// by increasing names, so elements selected meanwhile come if their name is after the cursor
 	assert(this);
-	cntHashkey key;
-	if (cntHash_each(this->elmnts, &key, NULL)) {
-		return key.ptr;
-	} else {
-		return NULL;
+	unsigned name;
+	while ( (name = GridSel_next_name(this, this->cursor)) != UINT_MAX ) {
+		this->cursor = name+1;
+		void *elmnt = ElmntTable_get(this->table, name);
+		if (elmnt) return elmnt;
 	}
+	this->cursor = this->nb_words * WORD_BITS;
+	return NULL;
+}
+
+unsigned GridSel_next_name(const GridSel *this, unsigned name) {
+	// first selected name from name (included), UINT_MAX if none
+	assert(this);
+	unsigned w = name / WORD_BITS;
+	if (w >= this->nb_words) return UINT_MAX;
+	uint64_t word = this->bits[w] & (~(uint64_t)0 << (name % WORD_BITS));
+	while (! word) {
+		if (++ w == this->nb_words) return UINT_MAX;
+		word = this->bits[w];
+	}
+	return w * WORD_BITS + __builtin_ctzll(word);
 }
 
 unsigned GridSel_size(GridSel *this) {
 	assert(this);
-	return cntHash_size(this->elmnts);
+	return this->size;
 }
 
-bool GridSel_selected(GridSel *this, void *elmnt) {
-	assert(this && elmnt);
-	return cntHash_get(this->elmnts, (cntHashkey){ .ptr = elmnt });
+GridSel *GridSel_expansion(GridSel *this, GridSel_type type) {
+	assert(this);
+	if (type == this->type) return this;
+	if (! this->cache) {
+		this->cache = mem_alloc(sizeof(*this->cache));
+		if (! this->cache) return NULL;
+		memset(this->cache, 0, sizeof(*this->cache));
+		for (unsigned t=0; t<3; t++) {
+			GridSel_construct(this->cache->expansions+t, t);
+		}
+	}
+	GridSelCache *cache = this->cache;
+	unsigned topology = Grid_topology_version();
+	if (cache->topologies[type] != topology || cache->versions[type] != this->version) {
+		GridSel_destruct(cache->expansions+type);
+		GridSel_convert(this, cache->expansions+type, type, GridSel_MIN);
+		cache->versions[type] = this->version;
+		cache->topologies[type] = topology;
+	}
+	return cache->expansions+type;
 }
 
 void GridSel_center(GridSel *sel, Vec *dest) {
 	assert(sel && dest);
-	GridSel tmp; bool tmp_used = false;
-	if (sel->type != GridSel_VERTEX) {
-		GridSel_convert(sel, &tmp, GridSel_VERTEX, GridSel_MIN);
-		tmp_used = true;
-		sel = &tmp;
+	if (sel->type == GridSel_FACET && GridSel_size(sel) == 1) {	// the facet knows it
+		GridIter it = GridSel_iter(sel);
+		*dest = *Facet_center(GridIter_next(&it));
+		return;
 	}
-	GridSel_reset(sel);
 	Vec_construct(dest, 0,0,0);
+	if (! (sel = GridSel_expansion(sel, GridSel_VERTEX))) return;
+	GridSel_reset(sel);
 	unsigned nb_vertices = 0;
 	Vertex *v;
 	while ( (v=GridSel_each(sel)) ) {
-		const Vec *pos = Vertex_position(v);
-		Vec_add(dest, pos);
+		Vec pos;
+		Vec_add(dest, Vertex_get_position(v, &pos));
 		nb_vertices ++;
 	}
 	Vec_scale(dest, 1./nb_vertices);
-	if (tmp_used) GridSel_destruct(&tmp);
 }
 
 void GridSel_apply_homotecy(GridSel *sel, Vec *center, Vec *axis, double ratio, void (*homotecy)(Vec *, Vec *, double)) {
 	assert(homotecy && sel);
-	GridSel tmp; bool tmp_used = false;
-	if (sel->type != GridSel_VERTEX) {
-		GridSel_convert(sel, &tmp, GridSel_VERTEX, GridSel_MIN);
-		tmp_used = true;
-		sel = &tmp;
-	}
+	if (! (sel = GridSel_expansion(sel, GridSel_VERTEX))) return;
 	GridSel_reset(sel);
 	Vertex *v;
 	while ( (v=GridSel_each(sel)) ) {
-		Vec *pos = Vertex_position(v);
-		if (center) Vec_sub(pos, center);
-		homotecy(pos, axis, ratio);
-		if (center) Vec_add(pos, center);
-		for (unsigned f=0; f<Vertex_size(v); f++) {
-			Facet *facet = Vertex_get_facet(v, f);
-			if (facet) Facet_invalidate_normal(facet);
-		}
+		Vec pos;
+		Vertex_get_position(v, &pos);
+		if (center) Vec_sub(&pos, center);
+		homotecy(&pos, axis, ratio);
+		if (center) Vec_add(&pos, center);
+		Vertex_set_position(v, &pos);
+		Vertex_moved(v);
 	}
-	if (tmp_used) GridSel_destruct(&tmp);
 }
 
 int GridSel_set_hardskin(GridSel *this, unsigned basis) {
 	assert(this);
 	Basis_remove_instance(Grid_get_basis(basis));
-	GridSel tmp; bool tmp_used = false;
-	if (this->type != GridSel_VERTEX) {
-		GridSel_convert(this, &tmp, GridSel_VERTEX, GridSel_MIN);
-		tmp_used = true;
-		this = &tmp;
-	}
+	if (! (this = GridSel_expansion(this, GridSel_VERTEX))) return 0;
 	GridSel_reset(this);
 	Vertex *v;
 	while ( (v=GridSel_each(this)) ) {
 		Vertex_set_basis(v, basis, 0.);
 	}
-	if (tmp_used) GridSel_destruct(&tmp);
 	return 1;
 }
 
@@ -138,12 +249,7 @@ int GridSel_set_softskin(GridSel *this, unsigned bi) {
 	assert(this);
 	if (0==bi) return GridSel_set_hardskin(this, 0);
 	Basis_remove_instance(Grid_get_basis(bi));
-	GridSel tmp; bool tmp_used = false;
-	if (this->type != GridSel_VERTEX) {
-		GridSel_convert(this, &tmp, GridSel_VERTEX, GridSel_MIN);
-		tmp_used = true;
-		this = &tmp;
-	}
+	if (! (this = GridSel_expansion(this, GridSel_VERTEX))) return 0;
 	Basis *basis = Grid_get_basis(bi);
 	assert(basis);
 	Basis *father = Basis_get_father(basis);
@@ -151,68 +257,259 @@ int GridSel_set_softskin(GridSel *this, unsigned bi) {
 	Vertex *v;
 	while ( (v=GridSel_each(this)) ) {
 		double d1, d2;
-		Vec dep;
-		Vec_sub3(&dep, Vertex_position(v), Basis_position(basis));
+		Vec pos, dep;
+		Vertex_get_position(v, &pos);
+		Vec_sub3(&dep, &pos, Basis_position(basis));
 		d1 = Vec_norm2(&dep);
 		if (father) {
-			Vec_sub3(&dep, Vertex_position(v), Basis_position(father));
+			Vec_sub3(&dep, &pos, Basis_position(father));
 			d2 = Vec_norm2(&dep);
 		} else {
-			d2 = Vec_norm2(Vertex_position(v));
+			d2 = Vec_norm2(&pos);
 		}
 		Vertex_set_basis(v, bi, d1/(d1+d2));
 	}
-	if (tmp_used) GridSel_destruct(&tmp);
 	return 1;
 }
 
 int GridSel_set_color(GridSel *this, unsigned color) {
 	assert(this);
-	GridSel tmp; bool tmp_used = false;
-	if (this->type != GridSel_VERTEX) {
-		GridSel_convert(this, &tmp, GridSel_VERTEX, GridSel_MIN);
-		tmp_used = true;
-		this = &tmp;
-	}
+	if (! (this = GridSel_expansion(this, GridSel_VERTEX))) return 0;
 	GridSel_reset(this);
 	Vertex *v;
 	while ( (v=GridSel_each(this)) ) {
 		Vertex_set_color(v, color);
 	}
-	if (tmp_used) GridSel_destruct(&tmp);
 	return 1;
 }
 
-void GridSel_add_or_sub(GridSel *dest, GridSel *src, bool add) {
-	GridSel_reset(src);
-	void *elmnt;
-	while ( (elmnt = GridSel_each(src)) ) {
-		if (add) GridSel_add(dest, elmnt);
-		else GridSel_remove(dest, elmnt);
-	}
+int GridSel_add_or_sub(GridSel *dest, GridSel *src, bool add) {
+	assert(dest && src);
+	GridSelExpr d, s, res;
+	if (! GridSelExpr_construct_sel(&d, dest, dest->type) || ! GridSelExpr_construct_sel(&s, src, dest->type)) return 0;
+	GridSelExpr_construct(&res, add ? GridSelExpr_UNION : GridSelExpr_DIFFERENCE, &d, &s);
+	return GridSel_assign(dest, &res);
 }
 
 void GridSel_toggle_selection(GridSel *this) {
+	// what is not selected, among the elements of the grid
 	assert(this);
-	switch (this->type) {
-		case GridSel_VERTEX:
-			Grid_reset_vertices();
-			Vertex *v;
-			while ( (v=Grid_each_vertex())) GridSel_toggle(this, v);
-			break;
-		case GridSel_EDGE:
-			Grid_reset_edges();
-			Edge *e;
-			while ( (e=Grid_each_edge())) GridSel_toggle(this, e);
-			break;
-		case GridSel_FACET:
-			Grid_reset_facets();
-			Facet *f;
-			while ( (f=Grid_each_facet())) GridSel_toggle(this, f);
-			break;
-		default:
-			assert(0);
+	GridSelExpr sel, res;
+	(void)GridSelExpr_construct_sel(&sel, this, this->type);
+	GridSelExpr_construct(&res, GridSelExpr_COMPLEMENT, &sel, NULL);
+	(void)GridSel_assign(this, &res);
+}
+
+int GridSelExpr_construct_sel(GridSelExpr *this, GridSel *sel, GridSel_type type) {
+	assert(this && sel);
+	this->op = GridSelExpr_SEL;
+	this->type = type;
+	this->sel = GridSel_expansion(sel, type);
+	this->left = this->right = NULL;
+	return NULL != this->sel;
+}
+
+void GridSelExpr_construct(GridSelExpr *this, GridSelExpr_op op, const GridSelExpr *left, const GridSelExpr *right) {
+	assert(this && op != GridSelExpr_SEL && left);
+	assert(op == GridSelExpr_COMPLEMENT || (right && right->type == left->type));
+	this->op = op;
+	this->type = left->type;
+	this->sel = NULL;
+	this->left = left;
+	this->right = right;
+}
+
+int GridSel_assign(GridSel *this, const GridSelExpr *expr) {
+	// word by word, in one pass
+	assert(this && expr && expr->type == this->type);
+	unsigned nb_words = expr_nb_words(expr);
+	if (! GridSel_reserve(this, nb_words * WORD_BITS)) {
+		log_warning(LOG_IMPORTANT, "Cannot assign a selection of %u names", nb_words * WORD_BITS);
+		return 0;
+	}
+	for (unsigned w=0; w<this->nb_words; w++) {
+		uint64_t old = this->bits[w];
+		this->bits[w] = w < nb_words ? expr_word(expr, w) : 0;
+		if (this->holders) hold_changes(this, w, old, this->bits[w]);
+	}
+	this->size = popcount(this->bits, this->nb_words);
+	this->version ++;
+	return 1;
+}
+
+void GridSelHolders_construct(GridSelHolders *this) {
+	assert(this);
+	for (unsigned t=0; t<3; t++) {
+		this->slots[t] = NULL;
+		this->max_names[t] = 0;
+	}
+	for (unsigned s=0; s<GRIDSEL_SLOTS; s++) this->names[s] = 0;
+	this->nb_unslotted = 0;
+	this->ok = true;
+}
+
+void GridSelHolders_destruct(GridSelHolders *this) {
+	assert(this);
+	for (unsigned t=0; t<3; t++) {
+		if (this->slots[t]) mem_unregister(this->slots[t]);
+	}
+	GridSelHolders_construct(this);
+}
+
+void GridSelHolders_clear(GridSelHolders *this) {
+	// once every selection is detached, keeping the memory
+	assert(this);
+	for (unsigned t=0; t<3; t++) {
+		if (this->slots[t]) memset(this->slots[t], 0, this->max_names[t] * sizeof(*this->slots[t]));
+	}
+	for (unsigned s=0; s<GRIDSEL_SLOTS; s++) this->names[s] = 0;
+	this->nb_unslotted = 0;
+	this->ok = true;
+}
+
+void GridSelHolders_stats(const GridSelHolders *this, GridMemStats *stats) {
+	// added to the selections
+	assert(this && stats);
+	for (unsigned t=0; t<3; t++) {
+		stats->bytes += this->max_names[t] * sizeof(*this->slots[t]);
+		stats->used += this->max_names[t] * sizeof(*this->slots[t]);
+	}
+}
+
+void GridSel_stats(const GridSel *this, GridMemStats *stats) {
+	// added to the selections, with its expansions
+	assert(this && stats);
+	unsigned nb_words = (ElmntTable_nb_names(this->table) + WORD_BITS-1) / WORD_BITS;
+	stats->nb_elmnts += this->size;
+	stats->capacity += WORD_BITS * this->nb_words;
+	stats->bytes += this->nb_words * sizeof(*this->bits);
+	stats->used += (nb_words < this->nb_words ? nb_words : this->nb_words) * sizeof(*this->bits);
+	if (this->cache) {
+		stats->bytes += sizeof(*this->cache);
+		stats->used += sizeof(*this->cache);
+		for (unsigned t=0; t<3; t++) {
+			const GridSel *exp = this->cache->expansions+t;
+			stats->bytes += exp->nb_words * sizeof(*exp->bits);
+			stats->used += exp->nb_words * sizeof(*exp->bits);
+		}
+	}
+}
+
+void GridSel_attach(GridSel *this, GridSelHolders *holders, unsigned name) {
+	// this becomes the selection name of the grid
+	assert(this && holders && name && ! this->holders);
+	this->holders = holders;
+	for (this->slot = 0; this->slot < GRIDSEL_SLOTS && holders->names[this->slot]; this->slot++) ;
+	if (this->slot < GRIDSEL_SLOTS) {
+		holders->names[this->slot] = name;
+		GridSel_hold_all(this, true);
+	} else {
+		holders->nb_unslotted ++;
+	}
+}
+
+void GridSel_detach(GridSel *this) {
+	assert(this && this->holders);
+	if (this->slot < GRIDSEL_SLOTS) {
+		GridSel_hold_all(this, false);
+		this->holders->names[this->slot] = 0;
+	} else {
+		assert(this->holders->nb_unslotted > 0);
+		this->holders->nb_unslotted --;
+	}
+	this->holders = NULL;
+	this->slot = GRIDSEL_SLOTS;
+}
+
+void GridSel_hold(GridSel *this, unsigned name, bool held) {
+	// this selection now holds the element of that name, or not
+	assert(this && this->holders);
+	GridSelHolders *holders = this->holders;
+	if (this->slot == GRIDSEL_SLOTS || ! holders->ok) return;
+	unsigned t = this->type;
+	if (name >= holders->max_names[t]) {
+		if (! held) return;
+		unsigned max = 2*holders->max_names[t];
+		if (max <= name) max = name+1;
+		uint64_t *tmp = holders->slots[t] ? mem_realloc(holders->slots[t], max * sizeof(*tmp)) : mem_alloc(max * sizeof(*tmp));
+		if (! tmp) {
+			log_warning(LOG_IMPORTANT, "Cannot record the selections of element %u, all selections will be searched", name);
+			holders->ok = false;
+			return;
+		}
+		memset(tmp + holders->max_names[t], 0, (max - holders->max_names[t]) * sizeof(*tmp));
+		holders->slots[t] = tmp;
+		holders->max_names[t] = max;
+	}
+	uint64_t bit = (uint64_t)1 << this->slot;
+	if (held) {
+		holders->slots[t][name] |= bit;
+	} else {
+		holders->slots[t][name] &= ~bit;
+	}
+}
+
+void GridSel_hold_all(GridSel *this, bool held) {
+	assert(this && this->holders);
+	if (this->slot == GRIDSEL_SLOTS) return;
+	for (unsigned n = GridSel_next_name(this, 0); n != UINT_MAX; n = GridSel_next_name(this, n+1)) {
+		GridSel_hold(this, n, held);
+	}
+}
+
+void GridSel_move(GridSel *restrict this, GridSel *restrict src) {
+	assert(this && src && ! src->holders);
+	GridSelHolders *holders = this->holders;
+	unsigned slot = this->slot;
+	unsigned version = this->version;
+	GridSelCache *cache = this->cache;
+	if (holders) GridSel_hold_all(this, false);
+	if (this->bits) mem_unregister(this->bits);
+	drop_cache(src);
+	*this = *src;
+	this->holders = holders;
+	this->slot = slot;
+	this->version = version+1;
+	this->cache = cache;
+	if (holders) GridSel_hold_all(this, true);
+	GridSel_construct(src, src->type);
+}
+
+GridIter GridSel_iter(GridSel *this) {
+	// Selected elements, by increasing names
+	assert(this);
+	GridIter it = Grid_iter(this->type);
+	it.sel = this;
+	return it;
+}
+
+void GridSel_update_facets(GridSel *this) {
+	// normal, center and area of the selected facets, in one pass
+	assert(this && this->type == GridSel_FACET);
+	GridIter it = GridSel_iter(this);
+	(void)Grid_update_facets(&it);
+}
+
+void GridSel_update_normals(GridSel *this) {
+	// normals of the selected elements, and of the facets and vertices they depend on,
+	// packing only those : the facets around selected edges, and the vertices of any element
+	assert(this);
+	GridSel *vertices = GridSel_expansion(this, GridSel_VERTEX);
+	if (GridSel_EDGE == this->type) {
+		GridSel facets;
+		GridSel_convert(this, &facets, GridSel_FACET, GridSel_MAX);
+		GridIter it = GridSel_iter(&facets);
+		bool ok = Grid_update_facets(&it);
+		GridSel_destruct(&facets);
+		if (! ok) return;
+		it = GridSel_iter(this);
+		Grid_update_edges(&it);
+	} else if (GridSel_FACET == this->type) {
+		GridSel_update_facets(this);
 	}
+	if (! vertices) return;
+	GridIter it = GridSel_iter(vertices);
+	(void)Grid_update_vertices(&it);
 }
 
 
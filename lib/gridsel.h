@@ -26,17 +26,32 @@ int GridSel_destruct(GridSel *this);
 int GridSel_dup(GridSel *this, GridSel *source);
 void GridSel_reset(GridSel *this);
 void *GridSel_each(GridSel *this);
+GridIter GridSel_iter(GridSel *this);
+void GridSel_update_facets(GridSel *this);
+void GridSel_update_normals(GridSel *this);
 unsigned GridSel_size(GridSel *this);
 // my_result must not be constructed
 void GridSel_convert(GridSel *restrict this, GridSel *restrict my_result, GridSel_type type, GridSel_convert_type convert_type);
+// this converted to type (GridSel_MIN), kept until this or the topology changes. NULL if out of
+// memory. Belongs to this, and must not be modified.
+GridSel *GridSel_expansion(GridSel *this, GridSel_type type);
 void GridSel_propagate(GridSel *this, unsigned level);
-bool GridSel_selected(GridSel *this, void *elmnt);
+void GridSel_shrink(GridSel *this, unsigned level);
+// rings, if not NULL, gets by name the ring that brought each element in (or out), 0 for those
+// that were already on that side and UINT_MAX for the others
+int GridSel_rings(GridSel *this, unsigned level, bool grow, unsigned *rings, unsigned nb_names);
+// adds the elements which vertices are all in region, among those of the facets
+struct BVHRegion;
+int GridSel_select_in(GridSel *this, const struct BVHRegion *region);
+// adds the elements of the grid matching pred, converted to the type of this
+struct GridPred;
+int GridSel_select_if(GridSel *this, const struct GridPred *pred);
 void GridSel_center(GridSel *this, Vec *dest);
 void GridSel_apply_homotecy(GridSel *this, Vec *center, Vec *axis, double ratio, void (*homotecy)(Vec *, Vec *, double));
 int GridSel_set_hardskin(GridSel *this, unsigned basis);
 int GridSel_set_softskin(GridSel *this, unsigned bi);
 int GridSel_set_color(GridSel *this, unsigned color);
-void GridSel_add_or_sub(GridSel *this, GridSel *src, bool add);
+int GridSel_add_or_sub(GridSel *this, GridSel *src, bool add);
 void GridSel_toggle_selection(GridSel *this);
 GridSel GridSel_connect(GridSel *this, GridSel *restrict_to_facets, bool full_connect);
 GridSel GridSel_extrude(GridSel *this, bool dir_vertex, Vec *direction, double ratio);
@@ -50,34 +65,166 @@ void GridSel_mapping(GridSel *this, GridSel_mapping_type type, const Vec *pos, f
 // Set all selected vertices to these uv coords
 void GridSel_set_uv(GridSel *this, float uv_x, float uv_y);
 
-#include <libcnt/hash.h>
+/* Selected elements are a bitset of their names, with the number of bits set.
+ * The elements are found back by their names in the grid's tables.
+ */
+
+#include <stdint.h>
+#include "libmicromodel/vertex.h"
+#include "libmicromodel/edge.h"
+#include "libmicromodel/facet.h"
+
+/* The grid also records which of its selections hold each element, so that
+ * replacing an element only visits these. Selections beyond the first
+ * GRIDSEL_SLOTS get no slot, and are always visited.
+ */
+
+#define GRIDSEL_SLOTS 64
+
+typedef struct GridSelHolders {
+	uint64_t *slots[3];	// by type then element name, bit s for the selection in slot s
+	unsigned max_names[3];	// allocated in slots
+	unsigned names[GRIDSEL_SLOTS];	// of the selection in each slot, 0 if free
+	unsigned nb_unslotted;
+	bool ok;	// false once slots could not grow : every selection is to be visited
+} GridSelHolders;
 
 struct GridSel {
-	cntHash *elmnts;	// clefs = void *, pas de valeur
+	const struct ElmntTable *table;	// of the grid, for this type
+	uint64_t *bits;	// by name
+	unsigned nb_words;	// allocated in bits
+	unsigned size;	// bits set
+	unsigned cursor;	// next name for GridSel_each
 	GridSel_type type;
+	GridSelHolders *holders;	// of the grid, for its own selections only
+	unsigned slot;	// in holders, GRIDSEL_SLOTS if none
+	unsigned version;	// changed by every modification
+	struct GridSelCache *cache;	// for GridSel_expansion, allocated on first use
 };
 
+/* Selection expressions are views over their operands, that are not copied : each word
+ * of the result is computed from the same word of the operands, when the expression
+ * is assigned to a selection, which may be one of the operands.
+ */
+
+typedef enum { GridSelExpr_SEL, GridSelExpr_UNION, GridSelExpr_DIFFERENCE, GridSelExpr_COMPLEMENT } GridSelExpr_op;
+
+typedef struct GridSelExpr {
+	GridSelExpr_op op;
+	GridSel_type type;
+	const GridSel *sel;	// for GridSelExpr_SEL, of that type
+	const struct GridSelExpr *left, *right;	// operands of the others, right unused by the complement
+} GridSelExpr;
+
+// 0 if sel cannot be expanded to type
+int GridSelExpr_construct_sel(GridSelExpr *this, GridSel *sel, GridSel_type type);
+// left and right must outlive this
+void GridSelExpr_construct(GridSelExpr *this, GridSelExpr_op op, const GridSelExpr *left, const GridSelExpr *right);
+int GridSel_assign(GridSel *this, const GridSelExpr *expr);
+
+/* Predicates on the attributes of the elements, for GridSel_select_if.
+ */
+
+typedef enum { GridPred_NORMAL, GridPred_COLOR, GridPred_BASIS, GridPred_UV, GridPred_LONGER, GridPred_SHORTER } GridPred_type;
+
+typedef struct GridPred {
+	GridPred_type type;
+	Vec axis;	// unit, of the cone of normals
+	double value;	// cosine of the cone half angle, or length of the edges
+	unsigned name;	// of the color or basis
+	float min_uv[2], max_uv[2];
+} GridPred;
+
+typedef struct GridSelCache {
+	GridSel expansions[3];	// by type
+	unsigned versions[3];	// of the selection when expanded
+	unsigned topologies[3];	// topology version when expanded, 0 if not yet
+} GridSelCache;
+
+int GridSel_reserve(GridSel *this, unsigned nb_names);
+unsigned GridSel_next_name(const GridSel *this, unsigned name);
+void GridSelHolders_construct(GridSelHolders *this);
+void GridSelHolders_destruct(GridSelHolders *this);
+void GridSelHolders_clear(GridSelHolders *this);
+void GridSelHolders_stats(const GridSelHolders *this, GridMemStats *stats);
+void GridSel_stats(const GridSel *this, GridMemStats *stats);
+void GridSel_attach(GridSel *this, GridSelHolders *holders, unsigned name);
+void GridSel_detach(GridSel *this);
+void GridSel_hold(GridSel *this, unsigned name, bool held);
+void GridSel_hold_all(GridSel *this, bool held);
+// this takes the elements of src, which is left empty, and stays attached
+void GridSel_move(GridSel *restrict this, GridSel *restrict src);
+
 #include <stdlib.h>
 #include <assert.h>
-static inline void *GridSel_add(GridSel *this, void *element) {
+static inline unsigned GridSel_elmnt_name(GridSel_type type, void *element) {
+	switch (type) {
+		case GridSel_VERTEX:
+			return Vertex_name(element);
+		case GridSel_EDGE:
+			return Edge_name(element);
+		case GridSel_FACET:
+			break;
+	}
+	return Facet_name(element);
+}
+static inline unsigned GridSel_name(const GridSel *this, void *element) {
+	return GridSel_elmnt_name(this->type, element);
+}
+static inline bool GridSel_selected_name(const GridSel *this, unsigned name) {
 	assert(this);
-	return cntHash_put(this->elmnts, (cntHashkey){ .ptr = element }, NULL);
+	return name/64 < this->nb_words && (this->bits[name/64] >> (name%64) & 1);
 }
-static inline int GridSel_remove(GridSel *this, void *element) {
+static inline bool GridSel_selected(const GridSel *this, void *element) {
+	assert(this && element);
+	return GridSel_selected_name(this, GridSel_name(this, element));
+}
+static inline int GridSel_add_name(GridSel *this, unsigned name) {
 	assert(this);
-	return cntHash_remove(this->elmnts, (cntHashkey){ .ptr = element});
+	if (name/64 >= this->nb_words && ! GridSel_reserve(this, name+1)) return 0;
+	uint64_t bit = (uint64_t)1 << (name%64);
+	if (! (this->bits[name/64] & bit)) {
+		this->bits[name/64] |= bit;
+		this->size ++;
+		this->version ++;
+		if (this->holders) GridSel_hold(this, name, true);
+	}
+	return 1;
+}
+static inline void *GridSel_add(GridSel *this, void *element) {
+	assert(this && element);
+	return GridSel_add_name(this, GridSel_name(this, element)) ? element : NULL;
+}
+static inline int GridSel_remove(GridSel *this, void *element) {
+	assert(this && element);
+	if (! GridSel_selected(this, element)) return 0;
+	unsigned name = GridSel_name(this, element);
+	this->bits[name/64] &= ~((uint64_t)1 << (name%64));
+	this->size --;
+	this->version ++;
+	if (this->holders) GridSel_hold(this, name, false);
+	return 1;
 }
 static inline int GridSel_toggle(GridSel *this, void *element) {
 	assert(this);
-	if (cntHash_get(this->elmnts, (cntHashkey){ .ptr = element})) {
+	if (GridSel_selected(this, element)) {
 		return GridSel_remove(this, element);
 	} else {
 		return NULL != GridSel_add(this, element);
 	}
 }
+#include <string.h>
 static inline void GridSel_clear(GridSel *this) {
 	assert(this);
-	cntHash_clear(this->elmnts);
+	if (this->holders) GridSel_hold_all(this, false);
+	if (this->bits) memset(this->bits, 0, this->nb_words * sizeof(*this->bits));
+	this->size = 0;
+	this->version ++;
+}
+static inline uint64_t GridSelHolders_get(const GridSelHolders *this, GridSel_type type, unsigned name) {
+	// slots of the selections holding this element
+	assert(this && type < 3);
+	return name < this->max_names[type] ? this->slots[type][name] : 0;
 }
 
 #endif
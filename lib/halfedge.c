@@ -0,0 +1,184 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "../config.h"
+#include <assert.h>
+#include <stdint.h>
+#include <libcnt/mem.h>
+#include "libmicromodel/grid.h"
+#include "libmicromodel/halfedge.h"
+
+/* Private Functions */
+
+static void *grow(void *ptr, size_t size) {
+	void *tmp = ptr ? mem_realloc(ptr, size) : mem_alloc(size);
+	if (!tmp && ptr) mem_unregister(ptr);
+	return tmp;
+}
+
+static int HalfEdges_reserve(HalfEdges *this, uint32_t nb_vertices, uint32_t nb_edges, uint32_t nb_facets) {
+	assert(this);
+	if (nb_vertices > this->max_vertices) {
+		this->vertex_half = grow(this->vertex_half, nb_vertices*sizeof(*this->vertex_half));
+		this->vertices = grow(this->vertices, nb_vertices*sizeof(*this->vertices));
+		if (!this->vertex_half || !this->vertices) goto fail;
+		this->max_vertices = nb_vertices;
+	}
+	if (nb_edges > this->max_edges) {
+		this->next = grow(this->next, 2*nb_edges*sizeof(*this->next));
+		this->vertex = grow(this->vertex, 2*nb_edges*sizeof(*this->vertex));
+		this->facet = grow(this->facet, 2*nb_edges*sizeof(*this->facet));
+		this->edges = grow(this->edges, nb_edges*sizeof(*this->edges));
+		if (!this->next || !this->vertex || !this->facet || !this->edges) goto fail;
+		this->max_edges = nb_edges;
+	}
+	if (nb_facets > this->max_facets) {
+		this->facet_half = grow(this->facet_half, nb_facets*sizeof(*this->facet_half));
+		this->facets = grow(this->facets, nb_facets*sizeof(*this->facets));
+		if (!this->facet_half || !this->facets) goto fail;
+		this->max_facets = nb_facets;
+	}
+	return 1;
+fail:
+	HalfEdges_destruct(this);
+	return 0;
+}
+
+// From element names to their index, for the duration of a build
+static uint32_t *index_map(unsigned max_name) {
+	uint32_t *map = mem_alloc((max_name+1)*sizeof(*map));
+	if (map) for (unsigned n=0; n<=max_name; n++) map[n] = HALFEDGE_NONE;
+	return map;
+}
+
+/* Public Functions */
+
+int HalfEdges_construct(HalfEdges *this) {
+	assert(this);
+	this->version = 0;
+	this->nb_vertices = this->nb_edges = this->nb_facets = 0;
+	this->max_vertices = this->max_edges = this->max_facets = 0;
+	this->next = this->vertex = this->facet = NULL;
+	this->vertex_half = this->facet_half = NULL;
+	this->vertices = NULL;
+	this->edges = NULL;
+	this->facets = NULL;
+	return 1;
+}
+
+void HalfEdges_destruct(HalfEdges *this) {
+	assert(this);
+	void *tables[] = {
+		this->next, this->vertex, this->facet, this->vertex_half, this->facet_half,
+		this->vertices, this->edges, this->facets,
+	};
+	for (unsigned t=0; t<sizeof(tables)/sizeof(*tables); t++) {
+		if (tables[t]) mem_unregister(tables[t]);
+	}
+	HalfEdges_construct(this);
+}
+
+int HalfEdges_build(HalfEdges *this, unsigned version) {
+	// Number every elements of the current grid, then link the half-edges
+	assert(this && Grid_get());
+	unsigned nb_vertices, nb_edges, nb_facets;
+	Grid_size(&nb_vertices, &nb_edges, &nb_facets);
+	if (!HalfEdges_reserve(this, nb_vertices, nb_edges, nb_facets)) return 0;
+	this->nb_vertices = this->nb_edges = this->nb_facets = 0;
+	unsigned max_v = 0, max_e = 0, max_f = 0;
+	Vertex *v;
+	GridIter it = Grid_iter(GridSel_VERTEX);
+	while ( (v = GridIter_next(&it)) ) {
+		if (Vertex_name(v) > max_v) max_v = Vertex_name(v);
+		this->vertices[this->nb_vertices++] = v;
+	}
+	Edge *e;
+	it = Grid_iter(GridSel_EDGE);
+	while ( (e = GridIter_next(&it)) ) {
+		if (Edge_name(e) > max_e) max_e = Edge_name(e);
+		this->edges[this->nb_edges++] = e;
+	}
+	Facet *f;
+	it = Grid_iter(GridSel_FACET);
+	while ( (f = GridIter_next(&it)) ) {
+		if (Facet_name(f) > max_f) max_f = Facet_name(f);
+		this->facets[this->nb_facets++] = f;
+	}
+	assert(this->nb_vertices==nb_vertices && this->nb_edges==nb_edges && this->nb_facets==nb_facets);
+	uint32_t *v_idx = index_map(max_v);
+	uint32_t *e_idx = index_map(max_e);
+	uint32_t *f_idx = index_map(max_f);
+	int ret = 0;
+	if (!v_idx || !e_idx || !f_idx) goto quit;
+	for (uint32_t i=0; i<nb_vertices; i++) v_idx[Vertex_name(this->vertices[i])] = i;
+	for (uint32_t i=0; i<nb_facets; i++) f_idx[Facet_name(this->facets[i])] = i;
+	for (uint32_t i=0; i<nb_edges; i++) {
+		e = this->edges[i];
+		e_idx[Edge_name(e)] = i;
+		for (EdgeSide s=WEST; s<NB_SIDES; s++) {
+			uint32_t const h = 2*i + s;
+			this->vertex[h] = v_idx[Vertex_name(Edge_get_vertex(e, WEST==s ? SOUTH:NORTH))];
+			f = Edge_get_facet(e, s);
+			this->facet[h] = f ? f_idx[Facet_name(f)] : HALFEDGE_NONE;
+			this->next[h] = HALFEDGE_NONE;
+		}
+	}
+	for (uint32_t i=0; i<nb_facets; i++) {
+		f = this->facets[i];
+		unsigned const size = Facet_size(f);
+		this->facet_half[i] = HALFEDGE_NONE;
+		uint32_t previous = HALFEDGE_NONE;
+		for (unsigned o=0; o<size; o++) {
+			e = Facet_get_edge(f, o);
+			uint32_t const h = 2*e_idx[Edge_name(e)] + Facet_my_side(f, e);
+			if (HALFEDGE_NONE == previous) {
+				this->facet_half[i] = h;
+			} else {
+				this->next[previous] = h;
+			}
+			previous = h;
+		}
+		if (HALFEDGE_NONE != previous) this->next[previous] = this->facet_half[i];
+	}
+	for (uint32_t i=0; i<nb_vertices; i++) {
+		v = this->vertices[i];
+		this->vertex_half[i] = Vertex_size(v) ?
+			2*e_idx[Edge_name(Vertex_get_edge(v, 0))] + Vertex_my_pole(v, 0) :
+			HALFEDGE_NONE;
+	}
+	this->version = version;
+	ret = 1;
+quit:
+	if (v_idx) mem_unregister(v_idx);
+	if (e_idx) mem_unregister(e_idx);
+	if (f_idx) mem_unregister(f_idx);
+	return ret;
+}
+
+void HalfEdges_stats(const HalfEdges *this, GridMemStats *stats) {
+	// counted in half-edges
+	assert(this && stats);
+	size_t per_vertex = sizeof(*this->vertex_half) + sizeof(*this->vertices);
+	size_t per_edge = 2*(sizeof(*this->next) + sizeof(*this->vertex) + sizeof(*this->facet)) + sizeof(*this->edges);
+	size_t per_facet = sizeof(*this->facet_half) + sizeof(*this->facets);
+	stats->nb_elmnts = 2*this->nb_edges;
+	stats->capacity = 2*this->max_edges;
+	stats->bytes = this->max_vertices * per_vertex + this->max_edges * per_edge + this->max_facets * per_facet;
+	stats->used = this->nb_vertices * per_vertex + this->nb_edges * per_edge + this->nb_facets * per_facet;
+}
+
+// vi:ts=3:sw=3
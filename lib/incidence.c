@@ -0,0 +1,154 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "../config.h"
+#include <assert.h>
+#include <libcnt/mem.h>
+#include "libmicromodel/vertex.h"
+#include "libmicromodel/edge.h"
+#include "libmicromodel/facet.h"
+#include "incidence.h"
+
+/* Private Functions */
+
+static void *grow(void *ptr, size_t size) {
+	void *tmp = ptr ? mem_realloc(ptr, size) : mem_alloc(size);
+	if (!tmp && ptr) mem_unregister(ptr);
+	return tmp;
+}
+
+static int reserve(unsigned **array, unsigned *max, unsigned nb, unsigned per_name) {
+	// room for nb entries of per_name unsigned each, with some spare for the next builds
+	if (nb <= *max) return 1;
+	unsigned new_max = nb + nb/4 + 16;
+	*array = grow(*array, new_max * per_name * sizeof(**array));
+	if (! *array) {
+		*max = 0;
+		return 0;
+	}
+	*max = new_max;
+	return 1;
+}
+
+static int Incidence_reserve(Incidence *this, unsigned nb_vertex_edges, unsigned nb_facet_edges) {
+	// arrays allocated together share their max
+	assert(this);
+	unsigned max_edges = this->max_edges, max_facet_edges = this->max_facet_edges;
+	return
+		reserve(&this->vertex_start, &this->max_vertices, this->nb_vertices+1, 1) &&
+		reserve(&this->vertex_edges, &this->max_vertex_edges, nb_vertex_edges, 1) &&
+		reserve(&this->edge_vertices, &max_edges, this->nb_edges, 2) &&
+		reserve(&this->edge_facets, &this->max_edges, this->nb_edges, 2) &&
+		reserve(&this->facet_start, &this->max_facets, this->nb_facets+1, 1) &&
+		reserve(&this->facet_vertices, &max_facet_edges, nb_facet_edges, 1) &&
+		reserve(&this->facet_edges, &this->max_facet_edges, nb_facet_edges, 1);
+}
+
+/* Public Functions */
+
+void Incidence_construct(Incidence *this, const ElmntTable *vertices, const ElmntTable *edges, const ElmntTable *facets) {
+	assert(this && vertices && edges && facets);
+	this->vertices = vertices;
+	this->edges = edges;
+	this->facets = facets;
+	this->version = 0;
+	this->nb_vertices = this->nb_edges = this->nb_facets = 0;
+	this->max_vertices = this->max_edges = this->max_facets = 0;
+	this->nb_vertex_edges = this->max_vertex_edges = 0;
+	this->nb_facet_edges = this->max_facet_edges = 0;
+	this->vertex_start = this->vertex_edges = NULL;
+	this->edge_vertices = this->edge_facets = NULL;
+	this->facet_start = this->facet_edges = this->facet_vertices = NULL;
+}
+
+void Incidence_destruct(Incidence *this) {
+	assert(this);
+	unsigned *arrays[] = {
+		this->vertex_start, this->vertex_edges, this->edge_vertices, this->edge_facets,
+		this->facet_start, this->facet_edges, this->facet_vertices
+	};
+	for (unsigned a=0; a<sizeof(arrays)/sizeof(*arrays); a++) {
+		if (arrays[a]) mem_unregister(arrays[a]);
+	}
+	Incidence_construct(this, this->vertices, this->edges, this->facets);
+}
+
+void Incidence_clear(Incidence *this) {
+	// to be built again, in the same memory
+	assert(this);
+	this->version = 0;
+	this->nb_vertices = this->nb_edges = this->nb_facets = 0;
+	this->nb_vertex_edges = this->nb_facet_edges = 0;
+}
+
+int Incidence_build(Incidence *this, unsigned version) {
+	// tables for the grid topology of this version
+	assert(this && version);
+	if (version == this->version) return 1;
+	this->version = 0;
+	this->nb_vertices = ElmntTable_nb_names(this->vertices);
+	this->nb_edges = ElmntTable_nb_names(this->edges);
+	this->nb_facets = ElmntTable_nb_names(this->facets);
+	unsigned nb_vertex_edges = 0, nb_facet_edges = 0, n;
+	Vertex *v;
+	Facet *f;
+	for (n = 0; (v = ElmntTable_next(this->vertices, &n, UINT_MAX)); ) nb_vertex_edges += Vertex_size(v);
+	for (n = 0; (f = ElmntTable_next(this->facets, &n, UINT_MAX)); ) nb_facet_edges += Facet_size(f);
+	if (! Incidence_reserve(this, nb_vertex_edges, nb_facet_edges)) {
+		Incidence_destruct(this);
+		return 0;
+	}
+	// removed names get empty rows
+	unsigned k = 0;
+	for (n = 0; n < this->nb_vertices; n++) {
+		this->vertex_start[n] = k;
+		if (! (v = ElmntTable_get(this->vertices, n))) continue;
+		for (unsigned i=0; i<Vertex_size(v); i++) this->vertex_edges[k++] = Edge_name(Vertex_get_edge(v, i));
+	}
+	this->vertex_start[n] = this->nb_vertex_edges = k;
+	for (n = 0; n < this->nb_edges; n++) {
+		Edge *e = ElmntTable_get(this->edges, n);
+		for (unsigned i=0; i<2; i++) {
+			Vertex *pole = e ? Edge_get_vertex(e, SOUTH+i) : NULL;
+			Facet *side = e ? Edge_get_facet(e, WEST+i) : NULL;
+			this->edge_vertices[2*n+i] = pole ? Vertex_name(pole) : INCIDENCE_NONE;
+			this->edge_facets[2*n+i] = side ? Facet_name(side) : INCIDENCE_NONE;
+		}
+	}
+	k = 0;
+	for (n = 0; n < this->nb_facets; n++) {
+		this->facet_start[n] = k;
+		if (! (f = ElmntTable_get(this->facets, n))) continue;
+		for (unsigned i=0; i<Facet_size(f); i++, k++) {
+			this->facet_edges[k] = Edge_name(Facet_get_edge(f, i));
+			this->facet_vertices[k] = Vertex_name(Facet_get_vertex(f, i));
+		}
+	}
+	this->facet_start[n] = this->nb_facet_edges = k;
+	this->version = version;
+	return 1;
+}
+
+void Incidence_stats(const Incidence *this, GridMemStats *stats) {
+	// elements are incidences
+	assert(this && stats);
+	stats->nb_elmnts = this->nb_vertex_edges + 4*this->nb_edges + 2*this->nb_facet_edges;
+	stats->capacity = this->max_vertex_edges + 4*this->max_edges + 2*this->max_facet_edges;
+	stats->bytes = (this->max_vertices + this->max_facets + stats->capacity) * sizeof(unsigned);
+	stats->used = this->version ? (this->nb_vertices+1 + this->nb_facets+1 + stats->nb_elmnts) * sizeof(unsigned) : 0;
+}
+// vi:ts=3:sw=3
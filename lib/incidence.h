@@ -0,0 +1,58 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef INCIDENCE_H_060422
+#define INCIDENCE_H_060422
+
+/* Incidences of the grid elements, as flat tables indexed by names
+ * (compressed rows), so that selections can be converted in array passes.
+ * Built again, in the same memory, whenever the topology changed.
+ */
+
+#include <limits.h>
+#include "table.h"
+#include "libmicromodel/grid.h"
+
+#define INCIDENCE_NONE UINT_MAX	// missing facet of a border edge
+
+typedef struct Incidence {
+	const ElmntTable *vertices, *edges, *facets;	// of the grid
+	unsigned version;	// topology version of the grid these tables were built from, 0 if not built
+	unsigned nb_vertices, nb_edges, nb_facets;	// names covered
+	unsigned max_vertices, max_edges, max_facets;	// allocated
+	unsigned nb_vertex_edges, max_vertex_edges;
+	unsigned nb_facet_edges, max_facet_edges;
+	// vertex -> edges : vertex_edges[vertex_start[v]] to vertex_edges[vertex_start[v+1]-1]
+	unsigned *vertex_start;
+	unsigned *vertex_edges;
+	// edge -> vertices and facets, two per edge (SOUTH, NORTH and WEST, EAST)
+	unsigned *edge_vertices;
+	unsigned *edge_facets;
+	// facet -> edges and vertices, in the same order (vertex i starts edge i)
+	unsigned *facet_start;
+	unsigned *facet_edges;
+	unsigned *facet_vertices;
+} Incidence;
+
+void Incidence_construct(Incidence *this, const ElmntTable *vertices, const ElmntTable *edges, const ElmntTable *facets);
+void Incidence_destruct(Incidence *this);
+void Incidence_clear(Incidence *this);
+int Incidence_build(Incidence *this, unsigned version);
+void Incidence_stats(const Incidence *this, GridMemStats *stats);
+
+#endif
+// vi:ts=3:sw=3
@@ -50,7 +50,8 @@ static void Mapping_destruct(Mapping *this) {}
 
 static void Mapping_get_projection(Mapping *this, Vertex *v, float *uv_x, float *uv_y, bool along_normals) {
 	assert(this && v && uv_x && uv_y);
-	const Vec *vp = Vertex_position(v);
+	Vec position;
+	const Vec *vp = Vertex_get_position(v, &position);
 	Vec Mp = *this->pos;
 	Vec Mx = vec_x, My = vec_y, Mz = vec_z;
 	double r, d;
@@ -176,31 +177,29 @@ static void Mapping_get_projection(Mapping *this, Vertex *v, float *uv_x, float
 
 void GridSel_mapping(GridSel *this, GridSel_mapping_type type, const Vec *pos, float scale_x, float scale_y, float offset_x, float offset_y, bool along_normals) {
 	assert(this && pos);
-	GridSel vertices;
-	GridSel_convert(this, &vertices, GridSel_VERTEX, GridSel_MIN);
+	GridSel *vertices = GridSel_expansion(this, GridSel_VERTEX);
+	if (! vertices) return;
 	Mapping mapping;
 	Mapping_construct(&mapping, type, pos, scale_x, scale_y, offset_x, offset_y);
-	GridSel_reset(&vertices);
+	GridSel_reset(vertices);
 	Vertex *v;
-	while ( (v=GridSel_each(&vertices)) ) {
+	while ( (v=GridSel_each(vertices)) ) {
 		float uv_x, uv_y;
 		Mapping_get_projection(&mapping, v, &uv_x, &uv_y, along_normals);
 		Vertex_set_uv_mapping(v, uv_x, uv_y);
 	}
 	Mapping_destruct(&mapping);
-	GridSel_destruct(&vertices);
 }
 
 void GridSel_set_uv(GridSel *this, float uv_x, float uv_y) {
 	assert(this);
-	GridSel vertices;
-	GridSel_convert(this, &vertices, GridSel_VERTEX, GridSel_MIN);
-	GridSel_reset(&vertices);
+	GridSel *vertices = GridSel_expansion(this, GridSel_VERTEX);
+	if (! vertices) return;
+	GridSel_reset(vertices);
 	Vertex *v;
-	while ( (v=GridSel_each(&vertices)) ) {
+	while ( (v=GridSel_each(vertices)) ) {
 		Vertex_set_uv_mapping(v, uv_x, uv_y);
 	}
-	GridSel_destruct(&vertices);
 }
 
 // vi:ts=3:sw=3
@@ -26,13 +26,14 @@
 #include <libcnt/list.h>
 #include <libcnt/log.h>
 #include "libmicromodel/grid.h"
+#include "grid.h"
 
 /* Data Definitions */
 
 static const char *type_names[MCom_NB_TYPES] = {
 	"Vector", "Selection", "Index", "Integer", "Version", "Real", "Choice", "Geometry type", "Basis", "Color"
 };
-static bool ret_was_found;
+static PER_THREAD bool ret_was_found;
 
 #define NB_PRIMITIVES 7
 static int tetrahedron(void);
@@ -86,6 +87,18 @@ static int new_color(void);
 static int paint(void);
 static int ret(void);
 static int version(void);
+static int compact(void);
+static int memstats(void);
+static int shrink_selection(void);
+static int select_box(void);
+static int select_sphere(void);
+static int select_halfspace(void);
+static int select_cylinder(void);
+static int select_normal(void);
+static int select_color(void);
+static int select_basis(void);
+static int select_uv(void);
+static int select_length(void);
 
 /* Note : Beware to order the instructions by descending strlen, otherwise the quick'n dirty strncpys of mml2bin may fail !
  *        (for extr vs extr1 !)
@@ -605,6 +618,134 @@ static const struct {
 		{
 			{ MCom_VERSION, "Version number" },
 		}
+	}, {
+		compact,
+		"Compact",
+		"Renumber all vertices, edges and facets\nand store them contiguously",
+		"compact",
+		0,
+		{
+			{ 0, NULL },
+		}
+	}, {
+		memstats,
+		"Memory",
+		"Log how much memory the grid,\nits selections and the backrefs use",
+		"memstats",
+		0,
+		{
+			{ 0, NULL },
+		}
+	}, {
+		shrink_selection,
+		"Shrink",
+		"Shrink a selection from\nits borders",
+		"shrink",
+		2,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_INT, "Amount" },
+		}
+	}, {
+		select_box,
+		"Select box",
+		"Add to a selection what lies\nin a box",
+		"selbox",
+		3,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_VEC, "Minimum corner" },
+			{ MCom_VEC, "Maximum corner" },
+		}
+	}, {
+		select_sphere,
+		"Select sphere",
+		"Add to a selection what lies\nin a sphere",
+		"selsphere",
+		3,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_VEC, "Center" },
+			{ MCom_REAL, "Radius" },
+		}
+	}, {
+		select_halfspace,
+		"Select half",
+		"Add to a selection what lies\non one side of a plane",
+		"selhalf",
+		3,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_VEC, "Point of the plane" },
+			{ MCom_VEC, "Normal, toward the selected side" },
+		}
+	}, {
+		select_cylinder,
+		"Select cylinder",
+		"Add to a selection what lies\nin a cylinder",
+		"selcyl",
+		4,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_VEC, "Base center" },
+			{ MCom_VEC, "Top center" },
+			{ MCom_REAL, "Radius" },
+		}
+	}, {
+		select_normal,
+		"Select normal",
+		"Add to a selection the facets\nfacing a direction",
+		"selnormal",
+		3,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_VEC, "Direction" },
+			{ MCom_REAL, "Max angle" },
+		}
+	}, {
+		select_color,
+		"Select color",
+		"Add to a selection the vertices\nof a color",
+		"selcolor",
+		2,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_COLOR, "The color" },
+		}
+	}, {
+		select_basis,
+		"Select basis",
+		"Add to a selection the vertices\nof a basis",
+		"selbasis",
+		2,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_BASIS, "The basis" },
+		}
+	}, {
+		select_uv,
+		"Select UV",
+		"Add to a selection the vertices\nmapped in a rectangle",
+		"seluv",
+		5,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_REAL, "Min U" },
+			{ MCom_REAL, "Min V" },
+			{ MCom_REAL, "Max U" },
+			{ MCom_REAL, "Max V" },
+		}
+	}, {
+		select_length,
+		"Select length",
+		"Add to a selection the edges\nlonger or shorter than a length",
+		"sellength",
+		3,
+		{
+			{ MCom_SEL, "The selection" },
+			{ MCom_REAL, "Length" },
+			{ MCom_BOOL, "Shorter / longer" },
+		}
 	},
 };
 
@@ -612,7 +753,7 @@ static const struct {
 
 static const char *selType_names[3] = { "vertex", "edge", "facet" };
 
-struct {
+static PER_THREAD struct {
 	unsigned char command;
 	unsigned char param;
 	unsigned int was_backref:MAX_NB_PARAMS;
@@ -625,13 +766,15 @@ struct {
 	} params[MAX_NB_PARAMS];
 } current;
 
-cntList *backref_vecs = NULL;
-cntList *backref_sels = NULL;
-cntList *backref_reals = NULL;
-cntList *backref_bases = NULL;
-cntList *backref_colors = NULL;
-static unsigned next_sel_name, next_basis_name, next_color_name;
-static unsigned nb_backref_sels, nb_backref_vecs, nb_backref_reals, nb_backref_bases, nb_backref_colors;	// count the backrefs that were created in a command
+static PER_THREAD cntList *backref_vecs = NULL;
+static PER_THREAD cntList *backref_sels = NULL;
+static PER_THREAD cntList *backref_reals = NULL;
+static PER_THREAD cntList *backref_bases = NULL;
+static PER_THREAD cntList *backref_colors = NULL;
+static PER_THREAD unsigned next_sel_name, next_basis_name, next_color_name;
+static PER_THREAD unsigned nb_backref_sels, nb_backref_vecs, nb_backref_reals, nb_backref_bases, nb_backref_colors;	// count the backrefs that were created in a command
+static PER_THREAD MCom_validation validation = MCom_VALIDATE_NONE;
+static PER_THREAD bool memory_stats = false;
 
 /* Private Functions */
 
@@ -826,6 +969,36 @@ static int convert_selection(void) {
 static int propagate_selection(void) {
 	return Grid_propagate_selection(get_sel(0), get_integer(1));
 }
+static int shrink_selection(void) {
+	return Grid_shrink_selection(get_sel(0), get_integer(1));
+}
+static int select_box(void) {
+	return Grid_select_in_box(get_sel(0), get_vec(1), get_vec(2));
+}
+static int select_sphere(void) {
+	return Grid_select_in_sphere(get_sel(0), get_vec(1), get_real(2));
+}
+static int select_halfspace(void) {
+	return Grid_select_in_halfspace(get_sel(0), get_vec(1), get_vec(2));
+}
+static int select_cylinder(void) {
+	return Grid_select_in_cylinder(get_sel(0), get_vec(1), get_vec(2), get_real(3));
+}
+static int select_normal(void) {
+	return Grid_select_by_normal(get_sel(0), get_vec(1), get_real(2));
+}
+static int select_color(void) {
+	return Grid_select_by_color(get_sel(0), get_color(1));
+}
+static int select_basis(void) {
+	return Grid_select_by_basis(get_sel(0), get_basis(1));
+}
+static int select_uv(void) {
+	return Grid_select_by_uv(get_sel(0), get_real(1), get_real(2), get_real(3), get_real(4));
+}
+static int select_length(void) {
+	return Grid_select_by_length(get_sel(0), get_real(1), get_boolean(2));
+}
 static int scale(void) {
 	Grid_scale(get_sel(0), get_vec(1), get_real(2));
 	return 1;
@@ -898,6 +1071,13 @@ static int version(void) {
 	}
 	return 1;
 }
+static int compact(void) {
+	return Grid_compact();
+}
+static int memstats(void) {
+	MCom_log_memory_stats();
+	return 1;
+}
 
 /* Protected Functions */
 
@@ -911,6 +1091,66 @@ void MCom_reset(void) {
 	free_all();
 	if (Grid_get()) Grid_del();
 }
+void MCom_reuse(void) {
+	// Same as MCom_reset, but keep the grid memory for the next evaluation
+	ret_was_found = false;
+	current.command = UCHAR_MAX;
+	free_all();
+	if (Grid_get()) Grid_clear();
+}
+
+static bool grid_is_valid(void) {
+	// log what rules the last command broke
+	GridReport report;
+	if (! Grid_validate(&report, validation == MCom_VALIDATE_THOROUGH)) return true;
+	for (GridRule rule=0; rule<NB_GRID_RULES; rule++) {
+		unsigned nb = report.nb_violations[rule];
+		if (! nb) continue;
+		char names[GRID_REPORT_NAMES * 11 + 5] = "";	// a space and 10 digits each, then " ..."
+		size_t len = 0;
+		for (unsigned i=0; i<nb && i<GRID_REPORT_NAMES; i++) {
+			len += snprintf(names+len, sizeof(names)-len, " %u", report.names[rule][i]);
+		}
+		if (nb > GRID_REPORT_NAMES) snprintf(names+len, sizeof(names)-len, " ...");
+		log_warning(LOG_IMPORTANT, "Command '%s' broke rule %s, %u times :%s", commands[current.command].name, Grid_rule_description(rule), nb, names);
+	}
+	return false;
+}
+
+void MCom_set_validation(MCom_validation v) {
+	// for this thread, from the next command on
+	validation = v;
+}
+
+void MCom_set_memory_stats(bool on) {
+	// for this thread : high water marks are then sampled after each command,
+	// and MCom_binexec_all logs the stats when done
+	memory_stats = on;
+}
+
+void MCom_log_memory_stats(void) {
+	if (Grid_get()) {
+		GridMemStats stats[NB_GRID_MEMS];
+		Grid_memory_stats(stats);
+		size_t total = 0, total_high = 0;
+		for (GridMem m=0; m<NB_GRID_MEMS; m++) {
+			const GridMemStats *st = stats+m;
+			log_warning(LOG_IMPORTANT, "Memory : %-11s %9zu bytes, %5.1f%% used, %7u/%-7u elements, high water %9zu bytes",
+				Grid_memory_name(m), st->bytes, st->bytes ? 100.*st->used/st->bytes : 0., st->nb_elmnts, st->capacity, st->high_water);
+			total += st->bytes;
+			total_high += st->high_water;
+		}
+		log_warning(LOG_IMPORTANT, "Memory : total %zu bytes, high water %zu bytes", total, total_high);
+		unsigned sel;
+		Grid_reset_selections();
+		while ( (sel = Grid_each_selection()) ) {
+			log_warning(LOG_IMPORTANT, "Memory : selection %u of %u %s", sel, Grid_selection_size(sel), selType_names[Grid_get_selection_type(sel)]);
+		}
+	}
+	log_warning(LOG_IMPORTANT, "Memory : backrefs to %u vecs, %u sels, %u reals, %u bases, %u colors",
+		backref_vecs ? cntList_size(backref_vecs) : 0, backref_sels ? cntList_size(backref_sels) : 0, backref_reals ? cntList_size(backref_reals) : 0,
+		backref_bases ? cntList_size(backref_bases) : 0, backref_colors ? cntList_size(backref_colors) : 0);
+}
 
 int MCom_begin(unsigned char command) {
 	if (command >= NB_COMMANDS) {
@@ -999,6 +1239,8 @@ int MCom_end(void) {
 	int (* const exec)(void) = commands[current.command].execute;
 	
 	int ret = exec();
+	if (ret && validation != MCom_VALIDATE_NONE && Grid_get() && ! grid_is_valid()) ret = 0;
+	if (ret && memory_stats && Grid_get()) Grid_memory_stats(NULL);
 	if (ret) {	// some instructions create new objects accessible through backrefs.
 		if (exec == new_selection) {
 			add_sel_to_backrefs(next_sel_name ++);
@@ -1093,6 +1335,7 @@ unsigned MCom_binexec_all(unsigned char *bin, unsigned bin_size) {
 		}
 		s += r;
 	}
+	if (memory_stats) MCom_log_memory_stats();
 	return s;
 }
 
@@ -1105,7 +1348,7 @@ unsigned char MCom_query_nb_groups(void) {
 	return 5;
 }
 unsigned char MCom_query_sizeof_group(unsigned char group) {
-	static const unsigned char sizeof_group[] = { NB_PRIMITIVES, 11, 5, 9, 15 };
+	static const unsigned char sizeof_group[] = { NB_PRIMITIVES, 11, 5, 9, 27 };
 	assert(group < sizeof(sizeof_group)/sizeof(*sizeof_group));
 	return sizeof_group[group];
 }
@@ -1218,7 +1461,7 @@ const char *MCom_query_backref_sel_name(unsigned backref) {
 	else return "NONE";
 }
 const char *MCom_last_cmd_geta(void) {
-	static char geta_buf[MAX_MML_LINELEN];
+	static PER_THREAD char geta_buf[MAX_MML_LINELEN];
 	geta_buf[0] = '\0';
 	if (current.command == UCHAR_MAX) return geta_buf;
 	strcat(geta_buf, commands[current.command].instruction);
@@ -1265,7 +1508,7 @@ const char *MCom_last_cmd_geta(void) {
 	return geta_buf;
 }
 const unsigned char *Mcom_last_cmd_get(unsigned *size) {
-	static unsigned char get_buf[MAX_BIN_LINELEN];
+	static PER_THREAD unsigned char get_buf[MAX_BIN_LINELEN];
 	get_buf[0] = current.command;
 	get_buf[1] = current.was_backref;
 	unsigned offset = 2;
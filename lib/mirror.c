@@ -6,8 +6,8 @@
  * Data Definitions
  */
 
-static cntHash *mir_geom = NULL;
-Vec center, normal;
+static PER_THREAD cntHash *mir_geom = NULL;
+static PER_THREAD Vec center, normal;
 
 /*
  * Private Functions
@@ -33,10 +33,10 @@ static void mirror_r(GridSel *result, Facet *facet) {
 				if (mir_v) {
 					v[pole] = *mir_v;
 				} else {
-					Vec pos;
-					Vec_sub3(&pos, Vertex_position(orig_v), &center);
-					double s = Vec_scalar(&pos, &normal);
-					pos = *Vertex_position(orig_v);
+					Vec pos, dep;
+					Vertex_get_position(orig_v, &pos);
+					Vec_sub3(&dep, &pos, &center);
+					double s = Vec_scalar(&dep, &normal);
 					Vec_add_scale(&pos, -2.*s, &normal);
 					v[pole] = Grid_vertex_new(&pos, Vertex_basis(orig_v), Vertex_skin_ratio(orig_v), Vertex_uv_x(orig_v), Vertex_uv_y(orig_v));
 					Vertex_set_color(v[pole], Vertex_color(orig_v));
@@ -80,8 +80,9 @@ int Grid_mirror(unsigned name, unsigned result_selection) {
 	center = *Facet_center(mir_facet);
 	normal = *Facet_normal(mir_facet);
 	cntHash_put(mir_geom, (cntHashkey){ .ptr=mir_facet }, NULL);
-	Facet *facets[Facet_size(mir_facet)];
-	for (unsigned i=0; i<Facet_size(mir_facet); i++) {
+	unsigned const mir_size = Facet_size(mir_facet);
+	Facet *facets[mir_size];
+	for (unsigned i=0; i<mir_size; i++) {
 		Vertex *v = Facet_get_vertex(mir_facet, i);
 		Edge *e = Facet_get_edge(mir_facet, i);
 		assert(v && e);
@@ -92,7 +93,7 @@ int Grid_mirror(unsigned name, unsigned result_selection) {
 		Edge_remove_facet(e, mir_facet);
 	}
 	Grid_replace_facet(mir_facet, NULL);
-	for (unsigned i=0; i<Facet_size(mir_facet); i++) {
+	for (unsigned i=0; i<mir_size; i++) {
 		mirror_r(&my_result, facets[i]);
 	}
 	cntHash_del(mir_geom);
@@ -0,0 +1,330 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "../config.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <libcnt/mem.h>
+#include "grid.h"
+#include "normals.h"
+
+#define NORMALS_MIN_LOOPS 4096	// per thread
+#define NORMALS_MAX_THREADS 8
+
+/* Private Functions */
+
+static void *grow(void *ptr, size_t size) {
+	void *tmp = ptr ? mem_realloc(ptr, size) : mem_alloc(size);
+	if (!tmp && ptr) mem_unregister(ptr);
+	return tmp;
+}
+
+static int NormalBatch_reserve(NormalBatch *this, unsigned nb_loops, unsigned nb_points) {
+	assert(this);
+	if (nb_loops > this->max_loops) {
+		unsigned max = 2*nb_loops;
+		this->first = grow(this->first, (max+1)*sizeof(*this->first));
+		this->normals = grow(this->normals, max*sizeof(*this->normals));
+		this->centers = grow(this->centers, max*sizeof(*this->centers));
+		this->areas = grow(this->areas, max*sizeof(*this->areas));
+		this->elmnts = grow(this->elmnts, max*sizeof(*this->elmnts));
+		if (!this->first || !this->normals || !this->centers || !this->areas || !this->elmnts) goto fail;
+		this->max_loops = max;
+	}
+	if (nb_points > this->max_points) {
+		unsigned max = 2*nb_points;
+		double **coords[] = { &this->x, &this->y, &this->z, &this->cx, &this->cy, &this->cz };
+		for (unsigned c=0; c<sizeof(coords)/sizeof(*coords); c++) {
+			*coords[c] = grow(*coords[c], max*sizeof(**coords[c]));
+			if (!*coords[c]) goto fail;
+		}
+		this->max_points = max;
+	}
+	return 1;
+fail:
+	NormalBatch_destruct(this);
+	return 0;
+}
+
+static int NormalBatch_add_loop(NormalBatch *this, void *elmnt, unsigned nb_points) {
+	// make room for a loop of nb_points, that the caller fills from point first[nb_loops-1]
+	if (!NormalBatch_reserve(this, this->nb_loops+1, this->nb_points+nb_points)) return 0;
+	this->elmnts[this->nb_loops] = elmnt;
+	this->first[this->nb_loops] = this->nb_points;
+	this->nb_loops ++;
+	this->nb_points += nb_points;
+	this->first[this->nb_loops] = this->nb_points;
+	return 1;
+}
+
+static inline void NormalBatch_set_point(NormalBatch *this, unsigned k, const Vec *p) {
+	this->x[k] = p->c[0];
+	this->y[k] = p->c[1];
+	this->z[k] = p->c[2];
+}
+static inline void NormalBatch_set_vertex(NormalBatch *this, unsigned k, const Vertex *v) {
+	Vec p;
+	NormalBatch_set_point(this, k, Vertex_get_position(v, &p));
+}
+
+struct part {
+	NormalBatch *batch;
+	unsigned from, to;
+};
+
+static void cross_products(const double *restrict x, const double *restrict y, const double *restrict z, double *restrict cx, double *restrict cy, double *restrict cz, size_t begin, size_t end) {
+	// of each direction with the next one, as restrict arguments so that it vectorizes
+	for (size_t k=begin; k+1<end; k++) {
+		cx[k] = y[k]*z[k+1] - z[k]*y[k+1];
+		cy[k] = z[k]*x[k+1] - x[k]*z[k+1];
+		cz[k] = x[k]*y[k+1] - y[k]*x[k+1];
+	}
+}
+
+static void *compute_part(void *data) {
+	// Same computations than Normal_of_loop and Center_of_loop, in the same order so that the
+	// results are the same, but each step runs over whole arrays of coordinates.
+	struct part *part = data;
+	const NormalBatch *batch = part->batch;
+	const unsigned *first = batch->first;
+	double *x = batch->x, *y = batch->y, *z = batch->z;
+	const double *cx = batch->cx, *cy = batch->cy, *cz = batch->cz;
+	if (part->from >= part->to) return NULL;
+	// directions toward the points, from the reference of their loop
+	for (unsigned l = part->from; l < part->to; l++) {
+		unsigned const r = first[l], end = first[l+1];
+		if (batch->facets) {
+			Vec *center = batch->centers+l;
+			Vec_construct(center, 0., 0., 0.);
+			for (unsigned k=r+1; k<end; k++) {
+				center->c[0] += x[k];
+				center->c[1] += y[k];
+				center->c[2] += z[k];
+			}
+			if (end-r > 1) Vec_scale(center, 1./(end-r-1));
+		}
+		double const rx = x[r], ry = y[r], rz = z[r];
+		for (unsigned k=r+1; k<end; k++) {
+			x[k] -= rx;
+			y[k] -= ry;
+			z[k] -= rz;
+		}
+		if (! batch->facets) for (unsigned k=r+1; k<end; k++) {
+			double n = sqrt(x[k]*x[k] + y[k]*y[k] + z[k]*z[k]);
+			double inv = n > 0 ? 1./n : 1.;
+			x[k] *= inv;
+			y[k] *= inv;
+			z[k] *= inv;
+		}
+	}
+	// across loops : the last one of each is redone below
+	cross_products(x, y, z, batch->cx, batch->cy, batch->cz, first[part->from], first[part->to]);
+	for (unsigned l = part->from; l < part->to; l++) {
+		unsigned const r = first[l], last = first[l+1]-1;
+		double n[3] = { 0., 0., 0. };
+		if (last-r >= 3) {	// at least three points around
+			for (unsigned k=r+1; k<last; k++) {
+				n[0] += cx[k];
+				n[1] += cy[k];
+				n[2] += cz[k];
+			}
+			n[0] += y[last]*z[r+1] - z[last]*y[r+1];
+			n[1] += z[last]*x[r+1] - x[last]*z[r+1];
+			n[2] += x[last]*y[r+1] - y[last]*x[r+1];
+		}
+		Vec *normal = batch->normals+l;
+		Vec_construct(normal, n[0], n[1], n[2]);
+		double norm = Vec_norm(normal);
+		Vec_normalize(normal);
+		if (batch->facets) batch->areas[l] = .5 * norm;
+	}
+	return NULL;
+}
+
+static unsigned nb_threads(unsigned nb_loops) {
+	long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned nb = nb_loops / NORMALS_MIN_LOOPS;
+	if (nb_cpus > 0 && nb > (unsigned)nb_cpus) nb = nb_cpus;
+	if (nb > NORMALS_MAX_THREADS) nb = NORMALS_MAX_THREADS;
+	return nb ? nb : 1;
+}
+
+/* Public Functions */
+
+static inline void direction(double d[3], const double *p, const double *r, bool unit) {
+	d[0] = p[0]-r[0];
+	d[1] = p[1]-r[1];
+	d[2] = p[2]-r[2];
+	if (unit) {
+		double n = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+		if (n > 0) {
+			double inv = 1./n;
+			d[0] *= inv; d[1] *= inv; d[2] *= inv;
+		}
+	}
+}
+
+double Normal_of_loop(Vec *normal, const Vec *points, unsigned nb_points, bool unit) {
+	// points[0] is the reference, the loop is points[1] to points[nb_points-1].
+	// With unit, the directions toward the points are normalized, so that each one
+	// weights the same whatever its distance. Otherwise this is the Newell's normal,
+	// and the returned norm before normalization is twice the area of the loop.
+	assert(normal && points && nb_points > 0);
+	const double *r = points[0].c;
+	double n[3] = { 0., 0., 0. };
+	if (nb_points >= 4) {	// at least three points around
+		double prev[3], cur[3];
+		direction(cur, points[1].c, r, unit);
+		for (unsigned i=2; i<=nb_points; i++) {
+			prev[0] = cur[0]; prev[1] = cur[1]; prev[2] = cur[2];
+			direction(cur, points[i<nb_points ? i:1].c, r, unit);
+			n[0] += prev[1]*cur[2] - prev[2]*cur[1];
+			n[1] += prev[2]*cur[0] - prev[0]*cur[2];
+			n[2] += prev[0]*cur[1] - prev[1]*cur[0];
+		}
+	}
+	Vec_construct(normal, n[0], n[1], n[2]);
+	double norm = Vec_norm(normal);
+	Vec_normalize(normal);
+	return norm;
+}
+
+void Center_of_loop(Vec *center, const Vec *points, unsigned nb_points) {
+	// average of the points around, without the reference
+	assert(center && points && nb_points > 0);
+	Vec_construct(center, 0., 0., 0.);
+	for (unsigned i=1; i<nb_points; i++) Vec_add(center, points+i);
+	if (nb_points > 1) Vec_scale(center, 1./(nb_points-1));
+}
+
+void NormalBatch_construct(NormalBatch *this) {
+	assert(this);
+	this->nb_loops = this->max_loops = 0;
+	this->nb_points = this->max_points = 0;
+	this->facets = false;
+	this->first = NULL;
+	this->x = this->y = this->z = NULL;
+	this->cx = this->cy = this->cz = NULL;
+	this->normals = this->centers = NULL;
+	this->areas = NULL;
+	this->elmnts = NULL;
+}
+
+void NormalBatch_destruct(NormalBatch *this) {
+	assert(this);
+	if (this->first) mem_unregister(this->first);
+	double *coords[] = { this->x, this->y, this->z, this->cx, this->cy, this->cz };
+	for (unsigned c=0; c<sizeof(coords)/sizeof(*coords); c++) {
+		if (coords[c]) mem_unregister(coords[c]);
+	}
+	if (this->normals) mem_unregister(this->normals);
+	if (this->centers) mem_unregister(this->centers);
+	if (this->areas) mem_unregister(this->areas);
+	if (this->elmnts) mem_unregister(this->elmnts);
+	NormalBatch_construct(this);
+}
+
+void NormalBatch_clear(NormalBatch *this, bool facets) {
+	assert(this);
+	this->nb_loops = this->nb_points = 0;
+	this->facets = facets;
+}
+
+int NormalBatch_add_facet(NormalBatch *this, Facet *facet) {
+	// only if its normal is outdated
+	assert(this && facet && this->facets);
+	if (Facet_attr(facet)->normal_gen == Grid_normals_generation()) return 1;
+	unsigned size = Facet_size(facet);
+	if (!NormalBatch_add_loop(this, facet, size+1)) return 0;
+	unsigned const k = this->first[this->nb_loops-1];
+	for (unsigned i=0; i<size; i++) NormalBatch_set_vertex(this, k+1+i, Facet_get_vertex(facet, i));
+	if (size) NormalBatch_set_vertex(this, k, Facet_get_vertex(facet, 0));
+	else NormalBatch_set_point(this, k, &vec_origin);
+	return 1;
+}
+
+int NormalBatch_add_vertex(NormalBatch *this, Vertex *vertex) {
+	// only if its normal is outdated ; the normal of a vertex with 2 edges is the one of its edges
+	assert(this && vertex && !this->facets);
+	if (Vertex_attr(vertex)->normal_gen == Grid_normals_generation()) return 1;
+	unsigned size = Vertex_size(vertex);
+	if (size < 3) return 1;
+	if (!NormalBatch_add_loop(this, vertex, size+1)) return 0;
+	unsigned const k = this->first[this->nb_loops-1];
+	NormalBatch_set_vertex(this, k, vertex);
+	for (unsigned i=0; i<size; i++) NormalBatch_set_vertex(this, k+1+i, Vertex_get_vertex(vertex, i));
+	return 1;
+}
+
+void NormalBatch_compute(NormalBatch *this) {
+	// The loops are independant, so big batches are shared between threads
+	assert(this);
+	unsigned nb = nb_threads(this->nb_loops);
+	struct part parts[nb];
+	pthread_t threads[nb];
+	bool started[nb];
+	for (unsigned t=0; t<nb; t++) {
+		parts[t].batch = this;
+		parts[t].from = (unsigned)(((unsigned long long)this->nb_loops * t) / nb);
+		parts[t].to = (unsigned)(((unsigned long long)this->nb_loops * (t+1)) / nb);
+		started[t] = t > 0 && 0 == pthread_create(threads+t, NULL, compute_part, parts+t);
+	}
+	for (unsigned t=0; t<nb; t++) {
+		if (! started[t]) compute_part(parts+t);
+	}
+	for (unsigned t=1; t<nb; t++) {
+		if (started[t]) pthread_join(threads[t], NULL);
+	}
+}
+
+void NormalBatch_store_facets(NormalBatch *this) {
+	assert(this);
+	unsigned gen = Grid_normals_generation();
+	for (unsigned l=0; l<this->nb_loops; l++) {
+		FacetAttr *attr = Facet_attr(this->elmnts[l]);
+		attr->normal = this->normals[l];
+		attr->center = this->centers[l];
+		attr->area = this->areas[l];
+		attr->normal_gen = gen;
+	}
+}
+
+void NormalBatch_store_vertices(NormalBatch *this) {
+	assert(this);
+	unsigned gen = Grid_normals_generation();
+	for (unsigned l=0; l<this->nb_loops; l++) {
+		VertexAttr *attr = Vertex_attr(this->elmnts[l]);
+		attr->normal = this->normals[l];
+		attr->normal_gen = gen;
+	}
+}
+
+void NormalBatch_stats(const NormalBatch *this, GridMemStats *stats) {
+	// the loops of the last batch
+	assert(this && stats);
+	size_t per_loop = sizeof(*this->first) + sizeof(*this->normals) + sizeof(*this->centers) + sizeof(*this->areas) + sizeof(*this->elmnts);
+	stats->nb_elmnts = this->nb_loops;
+	stats->capacity = this->max_loops;
+	size_t per_point = 6 * sizeof(*this->x);
+	stats->bytes = this->max_loops * per_loop + (this->first ? sizeof(*this->first) : 0) + this->max_points * per_point;
+	stats->used = this->nb_loops * per_loop + this->nb_points * per_point;
+}
+
+// vi:ts=3:sw=3
@@ -0,0 +1,63 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef NORMALS_H_060402
+#define NORMALS_H_060402
+
+/* Normals computed in bulk, from packed points.
+ * Each loop is a reference point followed by the points around it, in turn
+ * order : the corners of a facet (the first one being the reference too), or
+ * the neighbours of a vertex. Its normal is the normalized sum of the cross
+ * products of two successive points seen from the reference (Newell's), or of
+ * their directions only for the vertices. The center and area of the facets
+ * come along.
+ */
+
+#include <stdbool.h>
+#include <libcnt/vec.h>
+#include "libmicromodel/vertex.h"
+#include "libmicromodel/grid.h"
+#include "libmicromodel/facet.h"
+
+typedef struct NormalBatch {
+	bool facets;	// else vertices
+	unsigned nb_loops, max_loops;
+	unsigned nb_points, max_points;
+	unsigned *first;	// loop l is from point first[l] (the reference) to point first[l+1]-1
+	double *x, *y, *z;	// the points, by coordinate ; turned into directions from the reference
+	double *cx, *cy, *cz;	// cross products of each direction with the next one
+	Vec *normals;	// one per loop, once computed
+	Vec *centers;	// for facets only
+	double *areas;
+	void **elmnts;	// the facet or vertex of each loop, all of the same type
+} NormalBatch;
+
+void NormalBatch_construct(NormalBatch *this);
+void NormalBatch_destruct(NormalBatch *this);
+void NormalBatch_clear(NormalBatch *this, bool facets);
+int NormalBatch_add_facet(NormalBatch *this, Facet *facet);
+int NormalBatch_add_vertex(NormalBatch *this, Vertex *vertex);
+void NormalBatch_compute(NormalBatch *this);
+void NormalBatch_store_facets(NormalBatch *this);
+void NormalBatch_store_vertices(NormalBatch *this);
+void NormalBatch_stats(const NormalBatch *this, GridMemStats *stats);
+
+double Normal_of_loop(Vec *normal, const Vec *points, unsigned nb_points, bool unit);
+void Center_of_loop(Vec *center, const Vec *points, unsigned nb_points);
+
+#endif
+// vi:ts=3:sw=3
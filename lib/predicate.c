@@ -0,0 +1,164 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "../config.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <libcnt/log.h>
+#include "libmicromodel/vertex.h"
+#include "libmicromodel/edge.h"
+#include "libmicromodel/facet.h"
+#include "gridsel.h"
+#include "grid.h"
+#include "table.h"
+
+/* Data Definitions */
+
+#define PREDICATE_MIN_ELMNTS 4096	// per thread
+#define PREDICATE_MAX_THREADS 8
+
+struct part {
+	const GridPred *pred;
+	const ElmntTable *table, *vertices;
+	uint64_t *bits;
+	unsigned from, to;	// names, multiple of 64 so that no two parts share a word
+	unsigned size;	// bits set
+};
+
+/* Private Functions */
+
+static GridSel_type pred_type(const GridPred *pred) {
+	switch (pred->type) {
+		case GridPred_NORMAL:
+			return GridSel_FACET;
+		case GridPred_LONGER:
+		case GridPred_SHORTER:
+			return GridSel_EDGE;
+		default:
+			break;
+	}
+	return GridSel_VERTEX;
+}
+
+static double edge_length(const struct part *part, const Edge *edge) {
+	Vec p0, p1;
+	Position_get(part->vertices, Vertex_name(Edge_get_vertex(edge, SOUTH)), &p0);
+	Position_get(part->vertices, Vertex_name(Edge_get_vertex(edge, NORTH)), &p1);
+	return Vec_dist(&p0, &p1);
+}
+
+static bool matches(const struct part *part, unsigned name, void *elmnt) {
+	// only reads the tables, and not the grid which belongs to another thread
+	const GridPred *pred = part->pred;
+	const Vec *normal;
+	const VertexAttr *attr;
+	switch (pred->type) {
+		case GridPred_NORMAL:
+			normal = &((const FacetAttr *)ElmntTable_row(part->table, FACET_ATTRS, name))->normal;	// up to date
+			return Vec_scalar(normal, &pred->axis) >= pred->value * Vec_norm(normal) && Vec_norm2(normal) > 0.;
+		case GridPred_COLOR:
+			attr = ElmntTable_row(part->table, VERTEX_ATTRS, name);
+			return attr->color == pred->name;
+		case GridPred_BASIS:
+			attr = ElmntTable_row(part->table, VERTEX_ATTRS, name);
+			return attr->basis == pred->name;
+		case GridPred_UV:
+			attr = ElmntTable_row(part->table, VERTEX_ATTRS, name);
+			return
+				attr->uv_x >= pred->min_uv[0] && attr->uv_x <= pred->max_uv[0] &&
+				attr->uv_y >= pred->min_uv[1] && attr->uv_y <= pred->max_uv[1];
+		case GridPred_LONGER:
+			return edge_length(part, elmnt) > pred->value;
+		case GridPred_SHORTER:
+			break;
+	}
+	return edge_length(part, elmnt) < pred->value;
+}
+
+static void *select_part(void *data) {
+	// a whole word of bits at a time, so that the loop does not branch on the result
+	struct part *part = data;
+	part->size = 0;
+	unsigned n = part->from;
+	void *elmnt;
+	while ( (elmnt = ElmntTable_next(part->table, &n, part->to)) ) {
+		unsigned name = n-1;
+		part->bits[name/64] |= (uint64_t)matches(part, name, elmnt) << (name%64);
+	}
+	for (unsigned w = part->from/64; w < (part->to+63)/64; w++) {
+		part->size += __builtin_popcountll(part->bits[w]);
+	}
+	return NULL;
+}
+
+static unsigned nb_threads(unsigned nb_elmnts) {
+	long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned nb = nb_elmnts / PREDICATE_MIN_ELMNTS;
+	if (nb_cpus > 0 && nb > (unsigned)nb_cpus) nb = nb_cpus;
+	if (nb > PREDICATE_MAX_THREADS) nb = PREDICATE_MAX_THREADS;
+	return nb ? nb : 1;
+}
+
+/* Public Functions */
+
+int GridSel_select_if(GridSel *this, const GridPred *pred) {
+	// The elements are only read, so the names are shared between threads, each
+	// filling its own words of a selection of the predicate type, added to this.
+	assert(this && pred);
+	GridSel_type type = pred_type(pred);
+	if (type == GridSel_FACET) {
+		GridIter facets = Grid_iter(GridSel_FACET);
+		if (! Grid_update_facets(&facets)) return 0;
+	}
+	GridSel found;
+	GridSel_construct(&found, type);
+	unsigned nb_names = ElmntTable_nb_names(found.table);
+	if (! GridSel_reserve(&found, nb_names)) {
+		log_warning(LOG_IMPORTANT, "Cannot select among %u elements", nb_names);
+		return 0;
+	}
+	unsigned nb = nb_threads(ElmntTable_size(found.table));
+	unsigned nb_words = (nb_names + 63) / 64;
+	struct part parts[nb];
+	pthread_t threads[nb];
+	bool started[nb];
+	for (unsigned t=0; t<nb; t++) {
+		parts[t].pred = pred;
+		parts[t].table = found.table;
+		parts[t].vertices = Grid_table(GridSel_VERTEX);
+		parts[t].bits = found.bits;
+		parts[t].from = (unsigned)(((unsigned long long)nb_words * t) / nb) * 64;
+		parts[t].to = (unsigned)(((unsigned long long)nb_words * (t+1)) / nb) * 64;
+		started[t] = t > 0 && 0 == pthread_create(threads+t, NULL, select_part, parts+t);
+	}
+	for (unsigned t=0; t<nb; t++) {
+		if (! started[t]) select_part(parts+t);
+	}
+	for (unsigned t=1; t<nb; t++) {
+		if (started[t]) pthread_join(threads[t], NULL);
+	}
+	for (unsigned t=0; t<nb; t++) found.size += parts[t].size;
+	int ret = GridSel_add_or_sub(this, &found, true);
+	GridSel_destruct(&found);
+	return ret;
+}
+
+// vi:ts=3:sw=3
@@ -0,0 +1,95 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "../config.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <libcnt/log.h>
+#include "libmicromodel/vertex.h"
+#include "libmicromodel/edge.h"
+#include "libmicromodel/facet.h"
+#include "gridsel.h"
+#include "grid.h"
+#include "table.h"
+#include "bvh.h"
+
+/* Data Definitions */
+
+struct select_in {
+	GridSel *this;
+	const BVHRegion *region;
+	GridSel tested, inside;	// vertices
+};
+
+/* Private Functions */
+
+static bool inside(struct select_in *s, Vertex *v) {
+	// each vertex is tested once, whatever the number of facets around it
+	unsigned name = Vertex_name(v);
+	if (! GridSel_selected_name(&s->tested, name)) {
+		GridSel_add_name(&s->tested, name);
+		Vec position;
+		if (BVHRegion_contains(s->region, Vertex_get_position(v, &position))) GridSel_add_name(&s->inside, name);
+	}
+	return GridSel_selected_name(&s->inside, name);
+}
+
+static bool select_facet_part(Facet *f, void *data) {
+	// what of this facet lies in the region
+	struct select_in *s = data;
+	unsigned nb_inside = 0;
+	for (unsigned i=0; i<Facet_size(f); i++) {
+		Vertex *v = Facet_get_vertex(f, i);
+		if (! inside(s, v)) continue;
+		nb_inside ++;
+		if (s->this->type == GridSel_VERTEX) GridSel_add(s->this, v);
+	}
+	if (s->this->type == GridSel_EDGE && nb_inside >= 2) {
+		for (unsigned i=0; i<Facet_size(f); i++) {
+			Edge *e = Facet_get_edge(f, i);
+			if (inside(s, Edge_get_vertex(e, SOUTH)) && inside(s, Edge_get_vertex(e, NORTH))) GridSel_add(s->this, e);
+		}
+	} else if (s->this->type == GridSel_FACET && nb_inside == Facet_size(f)) {
+		GridSel_add(s->this, f);
+	}
+	return true;
+}
+
+/* Public Functions */
+
+int GridSel_select_in(GridSel *this, const BVHRegion *region) {
+	// only the vertices of the facets the BVH finds near the region are tested
+	assert(this && region);
+	const BVH *bvh = Grid_bvh();
+	if (! bvh) return 0;
+	struct select_in s = { .this = this, .region = region };
+	GridSel_construct(&s.tested, GridSel_VERTEX);
+	GridSel_construct(&s.inside, GridSel_VERTEX);
+	// so that adding names cannot fail
+	unsigned nb_vertices = ElmntTable_nb_names(s.tested.table);
+	int ret = GridSel_reserve(&s.tested, nb_vertices) && GridSel_reserve(&s.inside, nb_vertices) && GridSel_reserve(this, ElmntTable_nb_names(this->table));
+	if (ret) {
+		BVH_region(bvh, region, select_facet_part, &s);
+	} else {
+		log_warning(LOG_IMPORTANT, "Cannot select among %u vertices", nb_vertices);
+	}
+	GridSel_destruct(&s.tested);
+	GridSel_destruct(&s.inside);
+	return ret;
+}
+
+// vi:ts=3:sw=3
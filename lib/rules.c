@@ -30,10 +30,17 @@
  * f2) two sucessive edges of a facet must share a vertice ;
  * f3) the used edges must be used by the facet ;
  *
+ * v1, v3, e1, e2, f1, f2 and f3 only look at the element and its direct
+ * connections ; v2, e3 and e4 search the rings around, and are only checked by
+ * a thorough validation.
  */
 
+#include "../config.h"
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "libmicromodel/vertex.h"
 #include "libmicromodel/edge.h"
 #include "libmicromodel/facet.h"
@@ -53,6 +60,7 @@ bool rule_v2(const Vertex *v) {
 			Vertex_get_edge(v, i+1==Vertex_size(v) ? 0:i+1)
 		};
 		Facet *f = Vertex_get_facet(v, i);
+		if (! f) return false;
 		unsigned j;
 		for (j=0; j<Facet_size(f); j++) {
 			if (Facet_get_edge(f, j) == e[0]) break;
@@ -152,3 +160,117 @@ bool rule_f3(const Facet *f) {
 	return true;
 }
 
+
+// Whole grid
+
+#define RULES_MIN_ELMNTS 4096	// per thread
+#define RULES_MAX_THREADS 8
+
+static const char *descriptions[NB_GRID_RULES] = {
+	"v1) a vertex must be connected to at least 2 distinct edges",
+	"v2) two adjascent connections to a vertex must be successive edges of the same facet",
+	"v3) all connections to a vertex must see this vertex as connected",
+	"e1) an edge must connect two distinct vertices",
+	"e2) an edge must be used by 2 distinct facets",
+	"e3) any connected vertices must see the edge as connected",
+	"e4) any neighboring facets must see the edge as theirs",
+	"f1) a facet must be composed of at least 2 distincts edges",
+	"f2) two sucessive edges of a facet must share a vertice",
+	"f3) the used edges must be used by the facet",
+};
+
+const char *Grid_rule_description(GridRule rule) {
+	assert(rule < NB_GRID_RULES);
+	return descriptions[rule];
+}
+
+struct part {
+	const ElmntTable *tables[3];	// by GridSel_type
+	unsigned from[3], to[3];	// names
+	bool thorough;
+	GridReport report;
+};
+
+static void violation(GridReport *report, GridRule rule, unsigned name) {
+	unsigned n = report->nb_violations[rule] ++;
+	if (n < GRID_REPORT_NAMES) report->names[rule][n] = name;
+}
+
+static void *check_part(void *data) {
+	struct part *part = data;
+	GridReport *report = &part->report;
+	memset(report, 0, sizeof(*report));
+	Vertex *v;
+	unsigned n = part->from[GridSel_VERTEX];
+	while ( (v = ElmntTable_next(part->tables[GridSel_VERTEX], &n, part->to[GridSel_VERTEX])) ) {
+		if (! rule_v1(v)) violation(report, GridRule_V1, Vertex_name(v));
+		if (! rule_v3(v)) violation(report, GridRule_V3, Vertex_name(v));
+		else if (part->thorough && ! rule_v2(v)) violation(report, GridRule_V2, Vertex_name(v));
+	}
+	Edge *e;
+	n = part->from[GridSel_EDGE];
+	while ( (e = ElmntTable_next(part->tables[GridSel_EDGE], &n, part->to[GridSel_EDGE])) ) {
+		if (! rule_e1(e)) violation(report, GridRule_E1, Edge_name(e));
+		if (! rule_e2(e)) violation(report, GridRule_E2, Edge_name(e));
+		if (! part->thorough) continue;
+		if (! rule_e3(e)) violation(report, GridRule_E3, Edge_name(e));
+		if (! rule_e4(e)) violation(report, GridRule_E4, Edge_name(e));
+	}
+	Facet *f;
+	n = part->from[GridSel_FACET];
+	while ( (f = ElmntTable_next(part->tables[GridSel_FACET], &n, part->to[GridSel_FACET])) ) {
+		if (! rule_f1(f)) violation(report, GridRule_F1, Facet_name(f));
+		if (! rule_f2(f)) violation(report, GridRule_F2, Facet_name(f));
+		if (! rule_f3(f)) violation(report, GridRule_F3, Facet_name(f));
+	}
+	return NULL;
+}
+
+static unsigned nb_threads(unsigned nb_elmnts) {
+	long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned nb = nb_elmnts / RULES_MIN_ELMNTS;
+	if (nb_cpus > 0 && nb > (unsigned)nb_cpus) nb = nb_cpus;
+	if (nb > RULES_MAX_THREADS) nb = RULES_MAX_THREADS;
+	return nb ? nb : 1;
+}
+
+unsigned Rules_check(const ElmntTable *vertices, const ElmntTable *edges, const ElmntTable *facets, bool thorough, GridReport *report) {
+	// Elements are only read, so the names are shared between threads.
+	// Parts are merged in order, so that the reported names are the lowest ones.
+	assert(vertices && edges && facets && report);
+	unsigned nb = nb_threads(ElmntTable_size(vertices) + ElmntTable_size(edges) + ElmntTable_size(facets));
+	struct part parts[nb];
+	pthread_t threads[nb];
+	bool started[nb];
+	for (unsigned t=0; t<nb; t++) {
+		parts[t].tables[GridSel_VERTEX] = vertices;
+		parts[t].tables[GridSel_EDGE] = edges;
+		parts[t].tables[GridSel_FACET] = facets;
+		for (unsigned type=0; type<3; type++) {
+			unsigned long long nb_names = ElmntTable_nb_names(parts[t].tables[type]);
+			parts[t].from[type] = (unsigned)((nb_names * t) / nb);
+			parts[t].to[type] = (unsigned)((nb_names * (t+1)) / nb);
+		}
+		parts[t].thorough = thorough;
+		started[t] = t > 0 && 0 == pthread_create(threads+t, NULL, check_part, parts+t);
+	}
+	for (unsigned t=0; t<nb; t++) {
+		if (! started[t]) check_part(parts+t);
+	}
+	for (unsigned t=1; t<nb; t++) {
+		if (started[t]) pthread_join(threads[t], NULL);
+	}
+	memset(report, 0, sizeof(*report));
+	unsigned total = 0;
+	for (unsigned t=0; t<nb; t++) {
+		for (GridRule rule=0; rule<NB_GRID_RULES; rule++) {
+			unsigned n = parts[t].report.nb_violations[rule];
+			for (unsigned i=0; i<n && i<GRID_REPORT_NAMES; i++) {
+				violation(report, rule, parts[t].report.names[rule][i]);
+			}
+			report->nb_violations[rule] += n - (n < GRID_REPORT_NAMES ? n : GRID_REPORT_NAMES);
+			total += n;
+		}
+	}
+	return total;
+}
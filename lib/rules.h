@@ -22,6 +22,8 @@
 #include "libmicromodel/vertex.h"
 #include "libmicromodel/edge.h"
 #include "libmicromodel/facet.h"
+#include "libmicromodel/grid.h"
+#include "table.h"
 
 bool rule_v1(const Vertex *v);
 bool rule_v2(const Vertex *v);
@@ -34,4 +36,6 @@ bool rule_f1(const Facet *v);
 bool rule_f2(const Facet *v);
 bool rule_f3(const Facet *v);
 
+unsigned Rules_check(const ElmntTable *vertices, const ElmntTable *edges, const ElmntTable *facets, bool thorough, GridReport *report);
+
 #endif
@@ -50,7 +50,8 @@ static void separate_loop(Edge **loop, unsigned loop_size, GridSel *new_facets)
 				}
 			} else {	// new vertex. when e==0, both vertices are new, and so we first separate from EAST.
 				if (e < loop_size-1) {
-					cov[pole] = Grid_vertex_new(Vertex_position(v[pole]), Vertex_basis(v[pole]),Vertex_skin_ratio(v[pole]),Vertex_uv_x(v[pole]),Vertex_uv_y(v[pole]));	// TODO : faire un Vertex_dup, Grid_vertex_dup ?
+					Vec position;
+					cov[pole] = Grid_vertex_new(Vertex_get_position(v[pole], &position), Vertex_basis(v[pole]),Vertex_skin_ratio(v[pole]),Vertex_uv_x(v[pole]),Vertex_uv_y(v[pole]));	// TODO : faire un Vertex_dup, Grid_vertex_dup ?
 				} else {	// for last edge, we must loop rather than creating a new edge
 					assert(very_first_cov);
 					cov[pole] = very_first_cov;
@@ -17,6 +17,8 @@
  */
 #include <math.h>
 #include <assert.h>
+#include <libcnt/mem.h>
+#include <libcnt/log.h>
 #include "libmicromodel/grid.h"
 #include "gridsel.h"
 
@@ -30,12 +32,24 @@ static double compute_height(const Vec *x, const Vec *y, const Vec *n) {
 	return .75-1.5*ang/(2*M_PI);
 }
 
-static Edge *cut(Edge *edge, GridSel *new_vertices, GridSel *facets, double softness) {
-	// Keep values that will be usefull to displace the new vertex
-	Vec y = *Edge_normal(edge);
+struct cut {	// what is needed to displace the new vertex, taken before any edge of the level is cut
+	Edge *edge;
+	double len;
+	Vec y;	// edge normal
+	Vec n[2];	// extremities normals
+};
+
+static void prepare_cut(struct cut *c, Edge *edge) {
+	c->edge = edge;
+	c->len = Edge_length(edge);
+	c->y = *Edge_normal(edge);
+	c->n[0] = *Vertex_normal(Edge_get_vertex(edge, SOUTH));
+	c->n[1] = *Vertex_normal(Edge_get_vertex(edge, NORTH));
+}
+
+static Edge *cut(const struct cut *c, GridSel *new_vertices, GridSel *facets, double softness) {
+	Edge *edge = c->edge;
 	Vertex *extrem1 = Edge_get_vertex(edge, SOUTH);
-	Vertex *extrem2 = Edge_get_vertex(edge, NORTH);
-	double len = Edge_length(edge);
 	// cut
 	Edge *e = Grid_edge_cut(edge, .5);
 	assert(e);
@@ -48,14 +62,18 @@ static Edge *cut(Edge *edge, GridSel *new_vertices, GridSel *facets, double soft
 		if (! GridSel_selected(facets, f)) break;
 	}
 	if (side == NB_SIDES) {
-		Vec x = *Vertex_position(extrem1);
-		Vec_sub(&x, Vertex_position(new_vertex));
+		Vec y = c->y;
+		Vec x, position;
+		Vertex_get_position(extrem1, &x);
+		Vec_sub(&x, Vertex_get_position(new_vertex, &position));
 		Vec_normalize(&x);
-		double h = compute_height(&x, &y, Vertex_normal(extrem1));
+		double h = compute_height(&x, &y, &c->n[0]);
 		Vec_scale(&x, -1);
-		h += compute_height(&x, &y, Vertex_normal(extrem2));
-		Vec_scale(&y, softness*h*.5*len);
-		Vec_add(Vertex_position(new_vertex), &y);
+		h += compute_height(&x, &y, &c->n[1]);
+		Vec_scale(&y, softness*h*.5*c->len);
+		Vec_add(&position, &y);
+		Vertex_set_position(new_vertex, &position);
+		Vertex_moved(new_vertex);
 	}
 	return e;
 }
@@ -70,11 +88,24 @@ GridSel GridSel_smooth(GridSel *this, unsigned level, double softness) {
 		GridSel new_edges, new_vertices;
 		GridSel_construct(&new_vertices, GridSel_VERTEX);
 		GridSel_construct(&new_edges, GridSel_EDGE);
+		// all the normals of the level are taken at once, before the first cut changes them
+		unsigned nb_cuts = GridSel_size(&edges), c = 0;
+		struct cut *cuts = mem_alloc((nb_cuts+1) * sizeof(*cuts));
+		if (! cuts) {
+			log_warning(LOG_IMPORTANT, "Cannot smooth %u edges", nb_cuts);
+			GridSel_destruct(&new_edges);
+			GridSel_destruct(&new_vertices);
+			break;
+		}
+		GridSel_update_normals(&edges);
 		GridSel_reset(&edges);
 		Edge *edge;
-		while ( (edge = GridSel_each(&edges)) ) {
-			GridSel_add(&new_edges, cut(edge, &new_vertices, this, softness));
+		while ( (edge = GridSel_each(&edges)) ) prepare_cut(&cuts[c++], edge);
+		assert(c == nb_cuts);
+		for (c = 0; c < nb_cuts; c++) {
+			GridSel_add(&new_edges, cut(&cuts[c], &new_vertices, this, softness));
 		}
+		mem_unregister(cuts);
 		GridSel_add_or_sub(&edges, &new_edges, true);
 		GridSel_destruct(&new_edges);
 		new_edges = GridSel_connect(&new_vertices, this, true);	// connect will add created facets in this
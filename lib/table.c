@@ -0,0 +1,179 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "../config.h"
+#include <assert.h>
+#include <string.h>
+#include <libcnt/mem.h>
+#include "table.h"
+
+/* Private Functions */
+
+static int ElmntTable_new_chunk(ElmntTable *this) {
+	if (this->nb_chunks == this->max_chunks) {
+		unsigned new_max = this->max_chunks ? 2*this->max_chunks : 8;
+		char **tmp = this->chunks ? mem_realloc(this->chunks, new_max*sizeof(*tmp)) : mem_alloc(new_max*sizeof(*tmp));
+		if (!tmp) return 0;
+		this->chunks = tmp;
+		this->max_chunks = new_max;
+	}
+	char *chunk = mem_alloc(this->chunk_size*this->elmnt_size);
+	if (!chunk) return 0;
+	this->chunks[this->nb_chunks++] = chunk;
+	return 1;
+}
+
+static void *ElmntTable_new_slot(ElmntTable *this) {
+	if (this->free_slots) {
+		void *slot = this->free_slots;
+		this->free_slots = *(void **)slot;
+		return slot;
+	}
+	if (!this->nb_used_chunks || this->nb_used == this->chunk_size) {
+		// chunks after the used ones were kept by ElmntTable_clear
+		if (this->nb_used_chunks == this->nb_chunks && !ElmntTable_new_chunk(this)) return NULL;
+		this->nb_used_chunks ++;
+		this->nb_used = 0;
+	}
+	return this->chunks[this->nb_used_chunks-1] + this->elmnt_size*this->nb_used++;
+}
+
+static void ElmntTable_free_slot(ElmntTable *this, void *slot) {
+	*(void **)slot = this->free_slots;
+	this->free_slots = slot;
+}
+
+/* Public Functions */
+
+int ElmntTable_construct(ElmntTable *this, size_t elmnt_size, unsigned chunk_size) {
+	assert(this && elmnt_size >= sizeof(void *) && chunk_size > 0);
+	this->elmnt_size = elmnt_size;
+	this->chunk_size = chunk_size;
+	this->nb_chunks = this->max_chunks = this->nb_used_chunks = 0;
+	this->chunks = NULL;
+	this->nb_used = 0;
+	this->free_slots = NULL;
+	this->by_name = NULL;
+	this->max_names = this->next_name = 0;
+	this->size = 0;
+	this->nb_columns = 0;
+	return 1;
+}
+
+void ElmntTable_construct_like(ElmntTable *this, const ElmntTable *model) {
+	// empty, with the same columns
+	assert(this && model);
+	ElmntTable_construct(this, model->elmnt_size, model->chunk_size);
+	for (unsigned c=0; c<model->nb_columns; c++) ElmntTable_add_column(this, model->column_size[c]);
+}
+
+unsigned ElmntTable_add_column(ElmntTable *this, size_t row_size) {
+	// before any name is given
+	assert(this && ! this->max_names && this->nb_columns < ELMNT_MAX_COLUMNS && row_size > 0);
+	this->column_size[this->nb_columns] = row_size;
+	this->columns[this->nb_columns] = NULL;
+	return this->nb_columns++;
+}
+
+void ElmntTable_copy_rows(ElmntTable *this, unsigned name, const ElmntTable *from, unsigned from_name) {
+	assert(this && from && this->nb_columns == from->nb_columns);
+	for (unsigned c=0; c<this->nb_columns; c++) {
+		memcpy(ElmntTable_row(this, c, name), ElmntTable_row(from, c, from_name), this->column_size[c]);
+	}
+}
+
+void ElmntTable_destruct(ElmntTable *this) {
+	// elements must have been destructed already ; the columns stay, empty
+	assert(this);
+	for (unsigned c=0; c<this->nb_chunks; c++) {
+		mem_unregister(this->chunks[c]);
+	}
+	if (this->chunks) mem_unregister(this->chunks);
+	if (this->by_name) mem_unregister(this->by_name);
+	for (unsigned c=0; c<this->nb_columns; c++) {
+		if (this->columns[c]) mem_unregister(this->columns[c]);
+	}
+	unsigned nb_columns = this->nb_columns;
+	ElmntTable_construct(this, this->elmnt_size, this->chunk_size);
+	for (unsigned c=0; c<nb_columns; c++) this->columns[c] = NULL;
+	this->nb_columns = nb_columns;
+}
+
+void ElmntTable_clear(ElmntTable *this) {
+	// Forget all elements (without destructing them), but keep the chunks
+	assert(this);
+	this->nb_used_chunks = 0;
+	this->nb_used = 0;
+	this->free_slots = NULL;
+	this->next_name = 0;
+	this->size = 0;
+}
+
+void *ElmntTable_new(ElmntTable *this, unsigned *name) {
+	// Allocate an element for the next name
+	assert(this && name);
+	if (this->next_name == this->max_names) {
+		unsigned new_max = this->max_names ? 2*this->max_names : this->chunk_size;
+		void **tmp = this->by_name ? mem_realloc(this->by_name, new_max*sizeof(*tmp)) : mem_alloc(new_max*sizeof(*tmp));
+		if (!tmp) return NULL;
+		this->by_name = tmp;
+		for (unsigned c=0; c<this->nb_columns; c++) {
+			size_t size = new_max*this->column_size[c];
+			char *column = this->columns[c] ? mem_realloc(this->columns[c], size) : mem_alloc(size);
+			if (!column) return NULL;	// by_name is bigger than max_names, which is harmless
+			this->columns[c] = column;
+		}
+		this->max_names = new_max;
+	}
+	void *slot = ElmntTable_new_slot(this);
+	if (!slot) return NULL;
+	*name = this->next_name++;
+	this->by_name[*name] = slot;
+	this->size ++;
+	return slot;
+}
+
+void ElmntTable_remove(ElmntTable *this, unsigned name) {
+	assert(this && name < this->next_name && this->by_name[name]);
+	ElmntTable_free_slot(this, this->by_name[name]);
+	this->by_name[name] = NULL;
+	this->size --;
+}
+
+void *ElmntTable_next(const ElmntTable *this, unsigned *name, unsigned end) {
+	// First element from *name (included) to end (excluded), *name is then set after it.
+	// Elements can be added or removed meanwhile.
+	assert(this && name);
+	if (end > this->next_name) end = this->next_name;
+	while (*name < end) {
+		void *elmnt = this->by_name[(*name)++];
+		if (elmnt) return elmnt;
+	}
+	return NULL;
+}
+
+void ElmntTable_stats(const ElmntTable *this, GridMemStats *stats) {
+	assert(this && stats);
+	stats->nb_elmnts = this->size;
+	stats->capacity = this->nb_chunks * this->chunk_size;
+	size_t per_name = sizeof(*this->by_name);
+	for (unsigned c=0; c<this->nb_columns; c++) per_name += this->column_size[c];
+	stats->bytes = (size_t)stats->capacity * this->elmnt_size + this->max_chunks * sizeof(*this->chunks) + this->max_names * per_name;
+	stats->used = (size_t)this->size * this->elmnt_size + this->next_name * per_name;
+}
+
+// vi:ts=3:sw=3
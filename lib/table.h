@@ -0,0 +1,80 @@
+/* This file is part of MicroModel.
+ *
+ * Copyright (C) 2006 Cedric Cellier.
+ *
+ * MicroModel is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2.
+ *
+ * MicroModel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with MicroModel; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef TABLE_H_060312
+#define TABLE_H_060312
+
+/* Storage for the elements of a grid, indexed by their names.
+ * Elements are allocated in chunks, so that their addresses never change,
+ * and the slots of removed elements are reused. Names are never reused.
+ * What is kept out of the elements is packed in columns, indexed by name too,
+ * which move when they grow : their rows are not to be kept across ElmntTable_new.
+ */
+
+#include <stddef.h>
+#include "libmicromodel/grid.h"
+
+#define ELMNT_MAX_COLUMNS 2
+
+typedef struct ElmntTable {
+	size_t elmnt_size;
+	unsigned chunk_size;	// number of elements per chunk
+	unsigned nb_chunks, max_chunks;
+	char **chunks;
+	unsigned nb_used_chunks;	// slots are taken from the last used chunk
+	unsigned nb_used;	// slots used in this chunk
+	void *free_slots;	// released slots, linked through themselves
+	void **by_name;	// NULL for removed names
+	unsigned max_names;	// allocated in by_name
+	unsigned next_name;
+	unsigned size;	// number of elements
+	unsigned nb_columns;
+	size_t column_size[ELMNT_MAX_COLUMNS];	// of a row
+	char *columns[ELMNT_MAX_COLUMNS];	// max_names rows each
+} ElmntTable;
+
+int ElmntTable_construct(ElmntTable *this, size_t elmnt_size, unsigned chunk_size);
+void ElmntTable_construct_like(ElmntTable *this, const ElmntTable *model);
+unsigned ElmntTable_add_column(ElmntTable *this, size_t row_size);
+void ElmntTable_copy_rows(ElmntTable *this, unsigned name, const ElmntTable *from, unsigned from_name);
+void ElmntTable_destruct(ElmntTable *this);
+void ElmntTable_clear(ElmntTable *this);
+void *ElmntTable_new(ElmntTable *this, unsigned *name);
+void ElmntTable_remove(ElmntTable *this, unsigned name);
+void *ElmntTable_next(const ElmntTable *this, unsigned *name, unsigned end);
+void ElmntTable_stats(const ElmntTable *this, GridMemStats *stats);
+
+#include <assert.h>
+static inline void *ElmntTable_get(const ElmntTable *this, unsigned name) {
+	assert(this);
+	return name < this->next_name ? this->by_name[name] : NULL;
+}
+static inline void *ElmntTable_row(const ElmntTable *this, unsigned column, unsigned name) {
+	assert(this && column < this->nb_columns && name < this->next_name);
+	return this->columns[column] + name*this->column_size[column];
+}
+static inline unsigned ElmntTable_nb_names(const ElmntTable *this) {
+	assert(this);
+	return this->next_name;
+}
+static inline unsigned ElmntTable_size(const ElmntTable *this) {
+	assert(this);
+	return this->size;
+}
+
+#endif
+// vi:ts=3:sw=3
@@ -18,42 +18,56 @@
 #include "../config.h"
 #include <assert.h>
 #include <math.h>
+#include <string.h>
+#include <libcnt/log.h>
 #include "libmicromodel/vertex.h"
 #include "libmicromodel/edge.h"
 #include "libmicromodel/facet.h"
 #include "libmicromodel/grid.h"
+#include "grid.h"
 #include "rules.h"
+#include "normals.h"
 #include <libcnt/vec.h>
 
-/* Data Definitions */
-
-static cntShelf *vertexEdges = NULL;
-
 /* Private Functions */
 
-static void vertexEdges_end(void) {
-	if (vertexEdges) {
-		cntShelf_del(vertexEdges);
-		vertexEdges = NULL;
+static int Vertex_reserve(Vertex *this, unsigned size) {
+	assert(this);
+	if (size <= Vertex_attr(this)->capacity) return 1;
+	unsigned new_capacity = Vertex_attr(this)->capacity ? Vertex_attr(this)->capacity : 4;
+	while (new_capacity < size) new_capacity <<= 1;
+	VertexEdge *tmp = Grid_alloc(this->vertexEdges, Vertex_attr(this)->capacity*sizeof(*tmp), new_capacity*sizeof(*tmp));
+	if (!tmp) return 0;
+	this->vertexEdges = tmp;
+	Vertex_attr(this)->capacity = new_capacity;
+	return 1;
+}
+
+static unsigned Vertex_edge_order(const Vertex *this, const Edge *edge) {
+	unsigned i;
+	for (i=0; i<this->size; i++) {
+		if (this->vertexEdges[i].edge == edge) break;
 	}
+	return i;
 }
 
-static int vertexEdges_init(void) {
-	if (vertexEdges) return 1;
-	vertexEdges = cntShelf_new(sizeof(VertexEdge), Grid_get_carac_size()*4);
-	atexit(vertexEdges_end);
-	return NULL != vertexEdges;
+// Facet that comes after (or before) this connection, turning around the vertex
+static inline Facet *VertexEdge_next_facet(const VertexEdge *ve) {
+	return Edge_get_facet(ve->edge, SOUTH==ve->pole ? WEST : EAST);	// Im south, next facet is then WEST
+}
+static inline Facet *VertexEdge_previous_facet(const VertexEdge *ve) {
+	return Edge_get_facet(ve->edge, SOUTH==ve->pole ? EAST : WEST);
 }
 
 // Check internal data structure, not topology
 static bool Vertex_is_valid(Vertex *this) {
 	assert(this);
-	// Check the VertexEdges list
-	VertexEdge *ve = this->first_vertexEdge;
-	for (unsigned i=0; i<this->size; i++) {
-		ve = ve->next;	// TODO we should also check that the same edge or vertexEdge is not used twice
+	if (this->size > Vertex_attr(this)->capacity) return false;
+	if (this->size && !this->vertexEdges) return false;
+	for (unsigned i=0; i<this->size; i++) {	// TODO we should also check that the same edge is not used twice
+		VertexEdge *ve = &this->vertexEdges[i];
+		if (!ve->edge || Edge_get_vertex(ve->edge, ve->pole) != this) return false;
 	}
-	if (ve != this->first_vertexEdge) return false;
 	return true;
 }
 
@@ -61,110 +75,130 @@ static bool Vertex_is_valid(Vertex *this) {
 
 int Vertex_construct(Vertex *this, unsigned name, const Vec *position, unsigned basis, float skin_ratio, float uv_x, float uv_y) {
 	assert(this && position);
-	if (!vertexEdges_init()) return 0;
 	this->name = name;
 	this->size = 0;
-	this->first_vertexEdge = NULL;
-	this->position = *position;
-	this->normal_ok = false;
+	Vertex_attr(this)->capacity = 0;
+	this->vertexEdges = NULL;
+	Vertex_set_position(this, position);
+	Vertex_attr(this)->normal_gen = 0;
 	Vertex_set_basis(this, basis, skin_ratio);
 	Vertex_set_color(this, 0);
-	this->uv_x = uv_x;
-	this->uv_y = uv_y;
+	Vertex_attr(this)->uv_x = uv_x;
+	Vertex_attr(this)->uv_y = uv_y;
 	assert(Vertex_is_valid(this));
 	return 1;
 }
 
 int Vertex_destruct(Vertex *this) {
 	assert(this);
-	VertexEdge *first_ve = this->first_vertexEdge;
-	if (!first_ve) return 1;
-	VertexEdge *ve = first_ve;
-	do {
-		void *to_free = ve;
-		ve = ve->next;
-		cntShelf_free(vertexEdges, to_free);
-	} while (ve != first_ve);
+	if (this->vertexEdges) {
+		Grid_free(this->vertexEdges, Vertex_attr(this)->capacity*sizeof(*this->vertexEdges));
+		this->vertexEdges = NULL;
+	}
+	this->size = 0;
 	return 1;
 }
 
 int Vertex_construct_average(Vertex *this, unsigned name, const Vertex *v1, const Vertex *v2, double ratio) {
 	assert(this && v1 && v2);
-	Vec pi;
-	Vec_sub3(&pi, &v2->position, &v1->position);
+	Vec p1, p2, pi;
+	Vec_sub3(&pi, Vertex_get_position(v2, &p2), Vertex_get_position(v1, &p1));
 	Vec_scale(&pi, ratio);
-	Vec_add(&pi, &v1->position);
-	float uv_x = v1->uv_x*ratio + v2->uv_x*(1.-ratio);
-	float uv_y = v1->uv_y*ratio + v2->uv_y*(1.-ratio);
-	if (v1->basis == v2->basis) {
-		if (!Vertex_construct(this, name, &pi, v1->basis, v2->skin_ratio*ratio+v1->skin_ratio*(1.-ratio), uv_x, uv_y)) {
+	Vec_add(&pi, &p1);
+	float uv_x = Vertex_attr(v1)->uv_x*ratio + Vertex_attr(v2)->uv_x*(1.-ratio);
+	float uv_y = Vertex_attr(v1)->uv_y*ratio + Vertex_attr(v2)->uv_y*(1.-ratio);
+	unsigned color = ratio <= .5 ? Vertex_attr(v1)->color:Vertex_attr(v2)->color;	// read before this is constructed, which may be v1 or v2
+	if (Vertex_attr(v1)->basis == Vertex_attr(v2)->basis) {
+		if (!Vertex_construct(this, name, &pi, Vertex_attr(v1)->basis, Vertex_attr(v2)->skin_ratio*ratio+Vertex_attr(v1)->skin_ratio*(1.-ratio), uv_x, uv_y)) {
 			return 0;
 		}
 	} else {
-		if (!Vertex_construct(this, name, &pi, ratio <= .5 ? v1->basis:v2->basis, ratio <= .5 ? v1->skin_ratio:v2->skin_ratio, uv_x, uv_y)) {
+		if (!Vertex_construct(this, name, &pi, ratio <= .5 ? Vertex_attr(v1)->basis:Vertex_attr(v2)->basis, ratio <= .5 ? Vertex_attr(v1)->skin_ratio:Vertex_attr(v2)->skin_ratio, uv_x, uv_y)) {
 			return 0;
 		}
 	}
-	this->color = ratio <= .5 ? v1->color:v2->color;
+	Vertex_attr(this)->color = color;
 	return 1;
 }
 
 void Vertex_set_basis(Vertex *this, unsigned basis, float skin_ratio) {
 	assert(this);
-	this->basis = basis;
-	this->skin_ratio = skin_ratio;
-	assert(this->basis>0 || skin_ratio==0);	// root has no father
+	Vertex_attr(this)->basis = basis;
+	Vertex_attr(this)->skin_ratio = skin_ratio;
+	assert(Vertex_attr(this)->basis>0 || skin_ratio==0);	// root has no father
 }
 
 void Vertex_add_edge(Vertex *this, Edge *edge) {
+	/* Connections are kept in the order of the facets around the vertex, so that the next facet
+	 * of a connection is the previous facet of the following one. The new edge is thus inserted
+	 * right after its predecessor or right before its successor. If it links two runs of connections
+	 * then the run that follows it is moved behind it. The first connection never moves.
+	 */
 	assert(this && edge);
-	this->normal_ok = false;
-	VertexEdge *ve = this->first_vertexEdge;
-	if (ve) do {
-		if (ve->edge == edge) return;
-		ve = ve->next;
-	} while (ve != this->first_vertexEdge);
-	VertexEdge *new_ve = cntShelf_alloc(vertexEdges);
-	assert(new_ve);
-	new_ve->edge = edge;
-	if (0 == this->size) {
-		this->first_vertexEdge = new_ve;
-		new_ve->next = new_ve;
-		this->size ++;
-		assert(Vertex_is_valid(this));
+	Vertex_attr(this)->normal_gen = 0;
+	unsigned const n = this->size;
+	if (Vertex_edge_order(this, edge) < n) return;
+	Grid_topology_changed();
+	if (!Vertex_reserve(this, n+1)) {
+		log_warning(LOG_IMPORTANT, "Cannot grow vertex %u", this->name);
 		return;
 	}
-	ve = this->first_vertexEdge;
-	new_ve->next = ve->next;
-	ve->next = new_ve;
-	this->size ++;
-	// reorder everything
-	VertexEdge *ve_;
-	unsigned i, i_;
+	VertexEdge new_ve = {
+		.edge = edge,
+		.pole = Edge_get_vertex(edge, SOUTH)==this ? SOUTH:NORTH,
+	};
+	assert(Edge_get_vertex(edge, new_ve.pole) == this);
 	assert(rule_v3(this));
-	for (i=0, ve=this->first_vertexEdge; i<this->size-1; i++, ve=ve->next) {
-		Facet *c_next;
-		if (Edge_get_vertex(ve->edge, SOUTH) == this) {	// Im south, next facet is then WEST
-			c_next = Edge_get_facet(ve->edge, WEST);
-		} else {
-			c_next = Edge_get_facet(ve->edge, EAST);
-		}
-		for (i_=i+1, ve_=ve->next; i_<this->size; i_++, ve_=ve_->next) {
-			Facet *c2_previous;	
-			if (Edge_get_vertex(ve_->edge, SOUTH) == this) {	// Im south, previous facet of c2 is then EAST
-				c2_previous = Edge_get_facet(ve_->edge, EAST);
-			} else {
-				c2_previous = Edge_get_facet(ve_->edge, WEST);
+	// look for our predecessor and successor
+	Facet *const c_previous = VertexEdge_previous_facet(&new_ve);
+	Facet *const c_next = VertexEdge_next_facet(&new_ve);
+	unsigned pred = n, succ = n;
+	for (unsigned i=0; i<n; i++) {
+		VertexEdge *ve = &this->vertexEdges[i];
+		if (pred == n && VertexEdge_next_facet(ve) == c_previous) pred = i;
+		if (succ == n && VertexEdge_previous_facet(ve) == c_next) succ = i;
+	}
+	unsigned ins = n;	// by default, append
+	if (pred < n) {
+		ins = pred+1;
+	} else if (succ > 0) {
+		ins = succ;
+	}
+	VertexEdge *const ves = this->vertexEdges;
+	memmove(ves+ins+1, ves+ins, (n-ins)*sizeof(*ves));
+	ves[ins] = new_ve;
+	this->size ++;
+	if (pred < n && succ < n) {
+		if (succ >= ins) succ ++;
+		unsigned const after = ins+1 < n+1 ? ins+1 : 0;
+		if (succ != after && succ != pred) {
+			// Move the run starting at succ right after us (cyclicaly), keeping the first connection in place
+			unsigned len = 1;
+			bool closing = false;	// the run ends with pred : nothing to move
+			while (len < this->size) {
+				unsigned i = (succ+len-1) % this->size;
+				unsigned j = (succ+len) % this->size;
+				if (i == pred) closing = true;
+				if (j == ins || VertexEdge_next_facet(&ves[i]) != VertexEdge_previous_facet(&ves[j])) break;
+				len ++;
 			}
-			if (c2_previous == c_next) {	// then c2 should come right after c
-				if (i_ > i+1) {
-					VertexEdge *ve_prev = ve->next;
-					while (ve_prev->next != ve_) ve_prev = ve_prev->next;
-					ve_prev->next = ve_->next;
-					ve_->next = ve->next;
-					ve->next = ve_;
+			if (!closing) {
+				VertexEdge ring[this->size];
+				unsigned k = 0;
+				for (unsigned i=0; i<this->size; i++) {
+					unsigned const d = (i + this->size - succ) % this->size;
+					if (d < len) continue;	// part of the run
+					ring[k++] = ves[i];
+					if (i == ins) {
+						for (unsigned l=0; l<len; l++) ring[k++] = ves[(succ+l) % this->size];
+					}
 				}
-				break;
+				assert(k == this->size);
+				// rotate so that the first connection stays first
+				unsigned first;
+				for (first=0; first<k && ring[first].edge != ves[0].edge; first++) ;
+				assert(first < k);
+				for (unsigned i=0; i<k; i++) ves[i] = ring[(first+i) % k];
 			}
 		}
 	}
@@ -173,54 +207,58 @@ void Vertex_add_edge(Vertex *this, Edge *edge) {
 
 void Vertex_change_connection(Vertex *this, Edge *old, Edge *new) {
 	assert(this && old && new);
-	this->normal_ok = false;
-	unsigned i;
-	VertexEdge *ve = this->first_vertexEdge;
-	assert(ve);
-	for (i=0; i<this->size; i++, ve=ve->next) {
-		if (ve->edge == old) break;
-	}
+	Vertex_attr(this)->normal_gen = 0;
+	Grid_topology_changed();
+	unsigned i = Vertex_edge_order(this, old);
 	assert(i<this->size);
-	ve->edge = new;
+	this->vertexEdges[i].edge = new;
+	this->vertexEdges[i].pole = Edge_get_vertex(new, SOUTH)==this ? SOUTH:NORTH;
 	assert(Vertex_is_valid(this));
 }
 
 // Edges are signaled
 void Vertex_move_connections(Vertex *this, Vertex *dest, Edge *from, Edge *to) {
+	// Moves the connections strictly between from and to
 	assert(this && dest && from && to && rule_v1(this));
-	this->normal_ok = false;
-	unsigned i = 0;
-	VertexEdge *ve = this->first_vertexEdge;
-	assert(ve);
-	while (ve->edge != from && i++ < this->size) ve = ve->next;
-	assert(i < this->size);
-	VertexEdge *previous = ve;
-	ve = ve->next;	// keep from and to here
-	i = 0;
-	while (ve->edge != to && i++ < this->size) {
-		Edge_change_vertex(ve->edge, this, dest);
-		Vertex_add_edge(dest, ve->edge);
-		previous->next = ve->next;
-		if (this->first_vertexEdge==ve) this->first_vertexEdge=previous;
-		cntShelf_free(vertexEdges, ve);
-		ve = previous->next;
-		this->size --;
-		assert(this->size>2);
+	Vertex_attr(this)->normal_gen = 0;
+	Grid_topology_changed();
+	unsigned const n = this->size;
+	unsigned const f = Vertex_edge_order(this, from);
+	unsigned const t = Vertex_edge_order(this, to);
+	assert(f < n && t < n);
+	VertexEdge kept[n];
+	unsigned nb_kept = 0;
+	for (unsigned i=(f+1)%n; i!=t; i=(i+1)%n) {
+		Edge *e = this->vertexEdges[i].edge;
+		Edge_change_vertex(e, this, dest);
+		Vertex_add_edge(dest, e);
 	}
-	assert(i < this->size);
+	if (f >= t && t > 0) {	// the first connection was moved : from becomes the first
+		kept[nb_kept++] = this->vertexEdges[f];
+		for (unsigned i=t; i!=f; i++) kept[nb_kept++] = this->vertexEdges[i];
+	} else {
+		for (unsigned i=0; i<n; i++) {
+			if (f < t ? (i <= f || i >= t) : (i >= t && i <= f)) kept[nb_kept++] = this->vertexEdges[i];
+		}
+	}
+	memcpy(this->vertexEdges, kept, nb_kept*sizeof(*kept));
+	this->size = nb_kept;
+	assert(this->size>2);
+	assert(Vertex_is_valid(this));
 }
 
 void Vertex_remove_connection(Vertex *this, Edge *edge) {
 	assert(this && edge);
-	this->normal_ok = false;
-	VertexEdge *ve = this->first_vertexEdge;
-	assert(ve);
-	while (ve->next->edge != edge) ve = ve->next;
-	if (this->first_vertexEdge == ve->next) this->first_vertexEdge = ve;
-	VertexEdge *to_free = ve->next;
-	ve->next = ve->next->next;
-	cntShelf_free(vertexEdges, to_free);
-	if (! --this->size) this->first_vertexEdge = NULL;
+	Vertex_attr(this)->normal_gen = 0;
+	Grid_topology_changed();
+	unsigned i = Vertex_edge_order(this, edge);
+	assert(i < this->size);
+	this->size --;
+	if (0 == i) {	// the last connection becomes the first
+		this->vertexEdges[0] = this->vertexEdges[this->size];
+	} else {
+		memmove(this->vertexEdges+i, this->vertexEdges+i+1, (this->size-i)*sizeof(*this->vertexEdges));
+	}
 	assert(Vertex_is_valid(this));
 	if (0 == this->size) {	// doom it (usefull for zap
 		Grid_replace_vertex(this, NULL);
@@ -234,45 +272,44 @@ unsigned Vertex_size(const Vertex *this) {
 	return this->size;
 }
 
+VertexAttr *Vertex_attr(const Vertex *this) {
+	assert(this);
+	return ElmntTable_row(Grid_table(GridSel_VERTEX), VERTEX_ATTRS, this->name);
+}
+
+Vec *Vertex_get_position(const Vertex *this, Vec *position) {
+	assert(this && position);
+	Position_get(Grid_table(GridSel_VERTEX), this->name, position);
+	return position;
+}
+
+void Vertex_set_position(Vertex *this, const Vec *position) {
+	assert(this && position);
+	Position_set(Grid_table(GridSel_VERTEX), this->name, position);
+}
+
 Edge *Vertex_get_edge(const Vertex *this, unsigned order) {
 	assert(this && order<Vertex_size(this));
-	VertexEdge *ve = this->first_vertexEdge;
-	assert(ve);
-	for ( ; order-- > 0 ; ) ve = ve->next;
-	return ve->edge;
+	return this->vertexEdges[order].edge;
 }
 
 Vertex *Vertex_get_vertex(const Vertex *this, unsigned order) {
 	assert(this && order<Vertex_size(this));
-	Edge *e = Vertex_get_edge(this, order);
-	Vertex *v = Edge_get_vertex(e, SOUTH);
-	if (this!=v) {
-		assert(Edge_get_vertex(e, NORTH) == this);
-		return v;
-	} else {
-		return Edge_get_vertex(e, NORTH);
-	}
+	VertexEdge *ve = &this->vertexEdges[order];
+	assert(Edge_get_vertex(ve->edge, ve->pole) == this);
+	return Edge_get_vertex(ve->edge, !ve->pole);
 }
 
 Facet *Vertex_get_facet(const Vertex *this, unsigned order) {
 	assert(this && order<Vertex_size(this));
-	Edge *e = Vertex_get_edge(this, order);
-	EdgePole my_pole = Vertex_my_pole(this, order);
-	EdgeSide side;
-	if (my_pole == SOUTH) side = WEST;
-	else side = EAST;
-	return Edge_get_facet(e, side);
+	return VertexEdge_next_facet(&this->vertexEdges[order]);
 }
 
 EdgePole Vertex_my_pole(const Vertex *this, unsigned order) {
 	assert(this && order<Vertex_size(this));
-	Edge *e = Vertex_get_edge(this, order);
-	if (this == Edge_get_vertex(e, SOUTH)) {
-		return SOUTH;
-	} else {
-		assert(this == Edge_get_vertex(e, NORTH));
-		return NORTH;
-	}
+	VertexEdge *ve = &this->vertexEdges[order];
+	assert(Edge_get_vertex(ve->edge, ve->pole) == this);
+	return ve->pole;
 }
 
 int Vertex_zap(Vertex *this) {
@@ -281,9 +318,11 @@ int Vertex_zap(Vertex *this) {
 	//assert(rule_v1(this));
 	double best_dist;
 	int best_neig = -1;
+	Vec position, neig_position;
+	Vertex_get_position(this, &position);
 	for (unsigned i=0; i<Vertex_size(this); i++) {
 		Vertex *v_neig = Vertex_get_vertex(this, i);
-		double dist = Vec_dist(Vertex_position(this), Vertex_position(v_neig));
+		double dist = Vec_dist(&position, Vertex_get_position(v_neig, &neig_position));
 		if (-1 == best_neig || dist < best_dist) {
 			// not allowable if v_neig and any other linked vertex are linked with each other 'secretly'
 			unsigned j;
@@ -329,45 +368,49 @@ int Vertex_zap(Vertex *this) {
 const Vec *Vertex_normal(Vertex *this) {
 	assert(this);
 	assert(rule_v1(this));
-	if (this->normal_ok) return &this->normal;
-	this->normal = vec_origin;
-	if (Vertex_size(this)<2) return &this->normal;
+	unsigned gen = Grid_normals_generation();
+	if (Vertex_attr(this)->normal_gen == gen) return &Vertex_attr(this)->normal;
+	Vertex_attr(this)->normal = vec_origin;
+	if (Vertex_size(this)<2) return &Vertex_attr(this)->normal;
 	if (Vertex_size(this)==2) return Edge_normal(Vertex_get_edge(this, 0));
-	const Vec *pos_ref = Vertex_position(this);
-	Vec pos[2];
-	pos[1] = *Vertex_position(Vertex_get_vertex(this, 0));
-	Vec_sub(&pos[1], pos_ref);
-	Vec_normalize(&pos[1]);
+	// same computation than Grid_update_normals, around the neighbours
+	Vec pos[Vertex_size(this)+1];
+	Vertex_get_position(this, pos);
+	for (unsigned i=0; i<Vertex_size(this); i++) Vertex_get_position(Vertex_get_vertex(this, i), pos+i+1);
+	Normal_of_loop(&Vertex_attr(this)->normal, pos, Vertex_size(this)+1, true);
+	Vertex_attr(this)->normal_gen = gen;
+	return &Vertex_attr(this)->normal;
+}
+
+void Vertex_invalidate_normal(Vertex *this) {
+	assert(this);
+	Vertex_attr(this)->normal_gen = 0;
+}
+
+void Vertex_moved(Vertex *this) {
+	// To be called after the position changed : the normals of the one ring depend on it
+	assert(this);
+	Grid_geometry_changed();
+	Vertex_attr(this)->normal_gen = 0;
 	for (unsigned i=0; i<Vertex_size(this); i++) {
-		pos[0] = pos[1];
-		pos[1] = *Vertex_position(Vertex_get_vertex(this, i<Vertex_size(this)-1 ? i+1:0));
-		Vec_sub(&pos[1], pos_ref);
-		Vec_normalize(&pos[1]);
-		Vec tmp;
-		Vec_product(&tmp, &pos[0], &pos[1]);
-		Vec_add(&this->normal, &tmp);
+		Vertex_invalidate_normal(Vertex_get_vertex(this, i));
+		Edge *edge = Vertex_get_edge(this, i);
+		for (EdgeSide side=0; side<NB_SIDES; side++) {
+			Facet *facet = Edge_get_facet(edge, side);
+			if (facet) Facet_invalidate_normal(facet);
+		}
 	}
-	Vec_normalize(&this->normal);
-	this->normal_ok = true;
-	return &this->normal;
 }
 
 double distance2_between_vertices(Vertex *v1, Vertex *v2) {
 	assert(v1 && v2);
-	Vec p1;
-	Vec_sub3(&p1, Vertex_position(v2), Vertex_position(v1));
-	return Vec_norm2(&p1);
+	Vec p1, p2;
+	Vec_sub(Vertex_get_position(v2, &p2), Vertex_get_position(v1, &p1));
+	return Vec_norm2(&p2);
 }
 
 Edge *vertices_are_connected(Vertex *v1, Vertex *v2) {
-	unsigned v1_size = Vertex_size(v1);
-	unsigned o1;
-	for (o1 = 0; o1 < v1_size; o1++) {
-		Vertex *v = Vertex_get_vertex(v1, o1);
-		assert(v);
-		if (v == v2) return Vertex_get_edge(v1, o1);
-	}
-	return NULL;
+	return Grid_edge_index_from_vertices(v1, v2);
 }
 
 Facet *vertices_are_connectable(Vertex *v1, Vertex *v2) {
@@ -396,10 +439,11 @@ double Vertex_max_cos_to(Vertex *this, Vertex *to, Facet *f) {
 	before = Vertex_get_vertex(this, o);
 	after = Vertex_get_vertex(this, (o+1)%Vertex_size(this));
 	assert(before && after);
-	Vec v0, v1, v2;
-	Vec_sub3(&v0, Vertex_position(before), Vertex_position(this));
-	Vec_sub3(&v1, Vertex_position(to), Vertex_position(this));
-	Vec_sub3(&v2, Vertex_position(after), Vertex_position(this));
+	Vec p, v0, v1, v2;
+	Vertex_get_position(this, &p);
+	Vec_sub(Vertex_get_position(before, &v0), &p);
+	Vec_sub(Vertex_get_position(to, &v1), &p);
+	Vec_sub(Vertex_get_position(after, &v2), &p);
 	Vec_normalize(&v0);
 	Vec_normalize(&v1);
 	Vec_normalize(&v2);
@@ -408,4 +452,26 @@ double Vertex_max_cos_to(Vertex *this, Vertex *to, Facet *f) {
 	return cos1 > cos2 ? cos1 : cos2;
 }
 
+void Vertex_relocate(Vertex *this, Edge *const *edges) {
+	// Our edges were moved : edges gives their new location, indexed by their former names.
+	// Also move our connections into a new array.
+	assert(this && edges);
+	VertexEdge *old = this->vertexEdges;
+	unsigned old_capacity = Vertex_attr(this)->capacity;
+	this->vertexEdges = NULL;
+	Vertex_attr(this)->capacity = 0;
+	if (this->size && !Vertex_reserve(this, this->size)) {
+		this->vertexEdges = old;
+		Vertex_attr(this)->capacity = old_capacity;
+	} else if (old) {
+		memcpy(this->vertexEdges, old, this->size*sizeof(*old));
+		Grid_free(old, old_capacity*sizeof(*old));
+	}
+	for (unsigned i=0; i<this->size; i++) {
+		VertexEdge *ve = &this->vertexEdges[i];
+		ve->edge = edges[Edge_name(ve->edge)];
+		assert(ve->edge);
+	}
+}
+
 // vi:ts=3:sw=3